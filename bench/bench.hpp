@@ -0,0 +1,60 @@
+#pragma once
+
+#include <types.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Minimal benchmark harness. Each bench_*.cpp exposes one suite function that
+// bench_main.cpp calls in turn; bench_run() times a case until it has run for
+// at least BENCH_MIN_SECONDS and prints the cost per item.
+
+#define BENCH_MIN_SECONDS 0.25
+
+// Optional substring filter on case names, set from the command line.
+extern const char* bench_filter;
+// Set by suites that also check results; game_bench then exits with 1.
+extern bool bench_failed;
+
+inline f64 bench_time()
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// `items` is the work done per call, e.g. samples converted. With a non-zero
+// `realtime_rate` (items per second of audio) the speed is also shown as a
+// multiple of real time and as the share of one core that real time playback takes.
+template <typename F>
+f64 bench_run(const char* name, u64 items, f64 realtime_rate, F func)
+{
+    if (bench_filter && !strstr(name, bench_filter))
+        return 0.0;
+
+    func();
+
+    u64 iterations = 0;
+    f64 start = bench_time();
+    f64 elapsed = 0.0;
+    do
+    {
+        func();
+        ++iterations;
+        elapsed = bench_time() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    f64 ns = elapsed * 1e9 / static_cast<f64>(iterations * items);
+    if (realtime_rate > 0.0)
+        printf("%-44s %9.3f ns/item %9.1f Mitems/s %10.1fx realtime %8.3f%% of a core\n", name, ns, 1e3 / ns,
+            1e9 / ns / realtime_rate, 100.0 * ns * realtime_rate / 1e9);
+    else
+        printf("%-44s %9.3f ns/item %9.1f Mitems/s\n", name, ns, 1e3 / ns);
+    return ns;
+}
+
+void bench_pcm();
+void bench_adpcm();
+void bench_resampler();
+void bench_synth();
+void bench_mixer();
+void bench_effects();
+void bench_input();
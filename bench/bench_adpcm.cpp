@@ -0,0 +1,90 @@
+#include "bench.hpp"
+#include <adpcm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+// 1024 byte stereo blocks, the usual layout for 44.1 kHz IMA-ADPCM WAV files.
+#define BENCH_ADPCM_BLOCK_BYTES 1024
+#define BENCH_ADPCM_BLOCKS 64
+#define BENCH_ADPCM_RATE 44100.0
+
+static const i16 BENCH_IMA_STEPS[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const i8 BENCH_IMA_INDEX[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+// Straightforward encoder for test material; the decoder is what is measured.
+static u32 bench_ima_encode(i32* predictor, i32* index, i32 sample)
+{
+    i32 step = BENCH_IMA_STEPS[*index];
+    i32 diff = sample - *predictor;
+    u32 nibble = 0;
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+
+    i32 delta = step >> 3;
+    if (diff >= step) { nibble |= 4; diff -= step; delta += step; }
+    if (diff >= step >> 1) { nibble |= 2; diff -= step >> 1; delta += step >> 1; }
+    if (diff >= step >> 2) { nibble |= 1; delta += step >> 2; }
+
+    i32 p = *predictor + (nibble & 8 ? -delta : delta);
+    *predictor = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+    i32 i = *index + BENCH_IMA_INDEX[nibble & 7];
+    *index = i < 0 ? 0 : i > 88 ? 88 : i;
+    return nibble;
+}
+
+void bench_adpcm()
+{
+    const i32 channels = 2;
+    const u32 block_frames = ima_adpcm_block_frames(BENCH_ADPCM_BLOCK_BYTES, channels);
+
+    // Music-like material: a few partials plus noise, encoded block by block.
+    std::vector<u8> data(BENCH_ADPCM_BLOCK_BYTES * BENCH_ADPCM_BLOCKS);
+    i32 predictor[2] = { 0, 0 };
+    i32 index[2] = { 0, 0 };
+    u32 t = 0;
+    for (u32 block = 0; block < BENCH_ADPCM_BLOCKS; ++block)
+    {
+        u8* out = data.data() + block * BENCH_ADPCM_BLOCK_BYTES;
+        std::vector<i32> pcm(block_frames * channels);
+        for (u32 i = 0; i < block_frames; ++i, ++t)
+            for (i32 c = 0; c < channels; ++c)
+                pcm[i * channels + c] = static_cast<i32>(9000.0 * sin(t * (0.031 + c * 0.007)) + 4000.0 * sin(t * 0.173) + (rand() % 2001 - 1000));
+
+        for (i32 c = 0; c < channels; ++c)
+        {
+            predictor[c] = pcm[c];
+            out[4 * c + 0] = static_cast<u8>(predictor[c]);
+            out[4 * c + 1] = static_cast<u8>(predictor[c] >> 8);
+            out[4 * c + 2] = static_cast<u8>(index[c]);
+            out[4 * c + 3] = 0;
+        }
+        u8* words = out + 4 * channels;
+        for (u32 frame = 1; frame < block_frames; frame += 8, words += 4 * channels)
+            for (i32 c = 0; c < channels; ++c)
+                for (u32 i = 0; i < 8; ++i)
+                {
+                    u32 nibble = bench_ima_encode(&predictor[c], &index[c], pcm[(frame + i) * channels + c]);
+                    words[4 * c + i / 2] |= static_cast<u8>(nibble << ((i & 1) * 4));
+                }
+    }
+
+    std::vector<i16> out(block_frames * channels);
+    bench_run("ima_adpcm_decode_block (stereo frames)", static_cast<u64>(block_frames) * BENCH_ADPCM_BLOCKS, BENCH_ADPCM_RATE, [&]() {
+        for (u32 block = 0; block < BENCH_ADPCM_BLOCKS; ++block)
+            ima_adpcm_decode_block(data.data() + block * BENCH_ADPCM_BLOCK_BYTES, BENCH_ADPCM_BLOCK_BYTES, channels, out.data(), block_frames);
+    });
+}
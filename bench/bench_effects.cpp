@@ -0,0 +1,57 @@
+#include "bench.hpp"
+#include <effects.hpp>
+#include <dsp.hpp>
+
+#include <vector>
+#include <cmath>
+
+// One mixer block of stereo, as a bus effect chain sees it.
+#define BENCH_EFFECT_FRAMES 256
+#define BENCH_EFFECT_RATE 44100
+
+static void bench_effect(const char* name, effect_t* effect)
+{
+    std::vector<f32> l(BENCH_EFFECT_FRAMES), r(BENCH_EFFECT_FRAMES);
+    for (u32 i = 0; i < BENCH_EFFECT_FRAMES; ++i)
+    {
+        l[i] = static_cast<f32>(sin(i * 0.05)) * 0.5f;
+        r[i] = static_cast<f32>(sin(i * 0.07)) * 0.5f;
+    }
+
+    f32* channels[2] = { l.data(), r.data() };
+    if (bench_run(name, BENCH_EFFECT_FRAMES, BENCH_EFFECT_RATE, [&]() {
+        effect_process(effect, channels, BENCH_EFFECT_FRAMES);
+    }) > 0.0)
+    {
+        // The effect's own accounting, as a game would read it.
+        effect_stats_t stats;
+        effect_get_stats(effect, &stats);
+        printf("%-44s %9.2f us/block %9.2f%% of a core\n", "", stats.block_avg_us, stats.load * 100.0);
+    }
+    effect_shutdown(effect);
+}
+
+void bench_effects()
+{
+    const u64 fp_state = dsp_flush_denormals();
+
+    std::vector<f32> interleaved(BENCH_EFFECT_FRAMES * 2, 0.25f), l(BENCH_EFFECT_FRAMES), r(BENCH_EFFECT_FRAMES);
+    bench_run("effects deinterleave + interleave", BENCH_EFFECT_FRAMES, BENCH_EFFECT_RATE, [&]() {
+        dsp_deinterleave(interleaved.data(), l.data(), r.data(), BENCH_EFFECT_FRAMES);
+        dsp_interleave(l.data(), r.data(), interleaved.data(), BENCH_EFFECT_FRAMES);
+    });
+
+    effect_t biquad;
+    if (effect_init_biquad(&biquad, BENCH_EFFECT_RATE, 2, EFFECT_BIQUAD_LOWPASS, 2000.0f, 0.707f, 0.0f))
+        bench_effect("effects biquad stereo", &biquad);
+
+    effect_t delay;
+    if (effect_init_delay(&delay, BENCH_EFFECT_RATE, 2, 1.0f, 0.3f, 0.5f, 0.3f))
+        bench_effect("effects delay stereo", &delay);
+
+    effect_t reverb;
+    if (effect_init_reverb(&reverb, BENCH_EFFECT_RATE, 2, 0.8f, 0.5f, 1.0f, 0.3f))
+        bench_effect("effects reverb stereo", &reverb);
+
+    dsp_restore_denormals(fp_state);
+}
@@ -0,0 +1,79 @@
+#include "bench.hpp"
+#include <device.hpp>
+#include <input.hpp>
+
+// Descriptions as input_describe() builds them for the devices a handheld or a desktop
+// exposes. Discovery opens every /dev/input node and keeps the best score, so each case
+// checks which device wins in every order.
+#define BENCH_INPUT_ALL_BUTTONS ((1u << GP_BTN_COUNT) - 1)
+#define BENCH_INPUT_ALL_AXES ((1u << GP_AXIS_COUNT) - 1)
+#define BENCH_INPUT_FACE_BUTTONS ((1u << GP_BTN_A) | (1u << GP_BTN_B) | (1u << GP_BTN_X) | (1u << GP_BTN_Y) | \
+    (1u << GP_BTN_L1) | (1u << GP_BTN_L2) | (1u << GP_BTN_R1) | (1u << GP_BTN_R2))
+
+static const input_device_desc_t bench_keyboard = { "AT Translated Set 2 keyboard", 0, 0, 105, false, false };
+static const input_device_desc_t bench_imu = { "Sony Interactive Entertainment Wireless Controller Motion Sensors",
+    0, (1u << GP_AXIS_LX) | (1u << GP_AXIS_LY), 0, false, true };
+static const input_device_desc_t bench_r36s = { "GO-Super Gamepad", BENCH_INPUT_ALL_BUTTONS, BENCH_INPUT_ALL_AXES, 0, true, false };
+static const input_device_desc_t bench_generic = { "USB Gamepad", BENCH_INPUT_FACE_BUTTONS, BENCH_INPUT_ALL_AXES, 0, true, false };
+
+struct bench_input_case_t
+{
+    const char* name;
+    const input_device_desc_t* devices[4];
+    u32 count;
+    const input_device_desc_t* expected;    // nullptr when no device should be picked
+};
+
+// Same rule as the backend: the first device with the highest non-negative score.
+static const input_device_desc_t* bench_pick(const input_device_desc_t* const* devices, u32 count, u32 first)
+{
+    const input_device_desc_t* best = nullptr;
+    i32 best_score = -1;
+    for (u32 i = 0; i < count; ++i)
+    {
+        const input_device_desc_t* device = devices[(first + i) % count];
+        i32 score = input_score_device(*device);
+        if (score > best_score)
+        {
+            best = device;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+void bench_input()
+{
+    static const bench_input_case_t cases[] =
+    {
+        { "r36s", { &bench_keyboard, &bench_imu, &bench_r36s }, 3, &bench_r36s },
+        { "generic pad", { &bench_keyboard, &bench_imu, &bench_generic }, 3, &bench_generic },
+        { "r36s and generic pad", { &bench_generic, &bench_r36s, &bench_keyboard }, 3, &bench_r36s },
+        { "no pad", { &bench_keyboard, &bench_imu }, 2, nullptr },
+    };
+
+    if (!bench_filter || strstr("input device choice", bench_filter))
+    {
+        for (const bench_input_case_t& c : cases)
+        {
+            // Every rotation of the list, since readdir() order is arbitrary.
+            bool ok = true;
+            for (u32 first = 0; first < c.count; ++first)
+                ok = ok && bench_pick(c.devices, c.count, first) == c.expected;
+            printf("input device choice, %-24s %s (expected %s)\n", c.name, ok ? "ok" : "FAILED",
+                c.expected ? c.expected->name : "none");
+            if (!ok)
+                bench_failed = true;
+        }
+    }
+
+    static const input_device_desc_t* const devices[] = { &bench_keyboard, &bench_imu, &bench_r36s, &bench_generic };
+    volatile i32 sink = 0;
+    bench_run("input_score_device", 4, 0.0, [&]() {
+        i32 total = 0;
+        for (const input_device_desc_t* device : devices)
+            total += input_score_device(*device);
+        sink = total;
+    });
+    (void)sink;
+}
@@ -0,0 +1,19 @@
+#include "bench.hpp"
+
+const char* bench_filter = nullptr;
+bool bench_failed = false;
+
+int main(int argc, char** args)
+{
+    if (argc > 1)
+        bench_filter = args[1];
+
+    bench_pcm();
+    bench_adpcm();
+    bench_resampler();
+    bench_synth();
+    bench_mixer();
+    bench_effects();
+    bench_input();
+    return bench_failed ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+#include "bench.hpp"
+#include <device.hpp>
+#include <mixer.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+#define BENCH_MIXER_FRAMES 256
+#define BENCH_MIXER_RATE 44100
+#define BENCH_MIXER_VOICES 32
+#define BENCH_MIXER_SOURCE_FRAMES 44100
+
+// Looping mono and stereo one-second sources, half the voices each, every voice at its
+// own pitch and pan. Pitch and pan move every block so the gain ramps and the
+// resampling steps change the way they would in a game.
+static void bench_voices(const char* name, bool modulate)
+{
+    // mixer_init() logs, so skip the setup of filtered out cases too.
+    if (bench_filter && !strstr(name, bench_filter))
+        return;
+
+    std::vector<i16> mono(BENCH_MIXER_SOURCE_FRAMES);
+    std::vector<i16> stereo(BENCH_MIXER_SOURCE_FRAMES * 2);
+    for (u32 i = 0; i < BENCH_MIXER_SOURCE_FRAMES; ++i)
+    {
+        mono[i] = static_cast<i16>(8000.0 * sin(i * 0.0627) + (rand() % 2001 - 1000));
+        stereo[2 * i + 0] = static_cast<i16>(8000.0 * sin(i * 0.0411));
+        stereo[2 * i + 1] = static_cast<i16>(8000.0 * sin(i * 0.0533));
+    }
+
+    mixer_t mixer;
+    if (!mixer_init(&mixer, BENCH_MIXER_RATE, 2, BENCH_MIXER_FRAMES, BENCH_MIXER_VOICES, 1))
+        return;
+
+    u32 ids[BENCH_MIXER_VOICES];
+    for (u32 v = 0; v < BENCH_MIXER_VOICES; ++v)
+    {
+        mixer_source_t source;
+        source.samples = v & 1 ? stereo.data() : mono.data();
+        source.channels = v & 1 ? 2 : 1;
+        source.frames = BENCH_MIXER_SOURCE_FRAMES;
+        source.sample_rate = v % 4 < 2 ? BENCH_MIXER_RATE : 22050;
+
+        mixer_voice_params_t params;
+        params.gain = 1.0f / BENCH_MIXER_VOICES;
+        params.pan = -1.0f + 2.0f * v / (BENCH_MIXER_VOICES - 1);
+        params.pitch = 0.5f + 1.5f * v / (BENCH_MIXER_VOICES - 1);
+        params.loop = true;
+        ids[v] = mixer_play(&mixer, source, params);
+    }
+
+    std::vector<f32> out(BENCH_MIXER_FRAMES * 2);
+    mixer_render_f32(&mixer, out.data(), BENCH_MIXER_FRAMES);
+
+    u32 block = 0;
+    bench_run(name, BENCH_MIXER_FRAMES, BENCH_MIXER_RATE, [&]() {
+        if (modulate)
+        {
+            f32 t = (block++ & 63) / 63.0f;
+            for (u32 v = 0; v < BENCH_MIXER_VOICES; ++v)
+            {
+                mixer_set_pitch(&mixer, ids[v], 0.5f + 1.5f * fmodf(t + v / 32.0f, 1.0f));
+                mixer_set_pan(&mixer, ids[v], sinf(6.2831853f * (t + v / 32.0f)));
+            }
+        }
+        mixer_render_f32(&mixer, out.data(), BENCH_MIXER_FRAMES);
+    });
+    mixer_shutdown(&mixer);
+}
+
+void bench_mixer()
+{
+    bench_voices("mixer 32 voices fixed pitch/pan", false);
+    bench_voices("mixer 32 voices moving pitch/pan", true);
+}
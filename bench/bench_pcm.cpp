@@ -0,0 +1,44 @@
+#include "bench.hpp"
+#include <pcm.hpp>
+
+#include <vector>
+#include <cstdlib>
+
+// One 256 frame stereo period, the default device configuration.
+#define BENCH_PCM_SAMPLES (256 * 2)
+#define BENCH_PCM_RATE (48000.0 * 2)
+
+void bench_pcm()
+{
+    std::vector<f32> floats(BENCH_PCM_SAMPLES);
+    std::vector<f32> scratch(BENCH_PCM_SAMPLES);
+    std::vector<i16> shorts(BENCH_PCM_SAMPLES);
+    for (u32 i = 0; i < BENCH_PCM_SAMPLES; ++i)
+        floats[i] = (rand() / static_cast<f32>(RAND_MAX)) * 2.4f - 1.2f;
+    pcm_f32_to_s16(floats.data(), shorts.data(), BENCH_PCM_SAMPLES);
+    pcm_dither_t dither;
+
+    bench_run("pcm_f32_to_s16", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        pcm_f32_to_s16(floats.data(), shorts.data(), BENCH_PCM_SAMPLES);
+    });
+    bench_run("pcm_f32_to_s16_scalar", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        pcm_f32_to_s16_scalar(floats.data(), shorts.data(), BENCH_PCM_SAMPLES);
+    });
+    bench_run("pcm_f32_to_s16_dither", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        pcm_f32_to_s16_dither(floats.data(), shorts.data(), BENCH_PCM_SAMPLES, &dither);
+    });
+    bench_run("pcm_f32_to_s16_dither_scalar", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        pcm_f32_to_s16_dither_scalar(floats.data(), shorts.data(), BENCH_PCM_SAMPLES, &dither);
+    });
+    // Includes the copy that refills the float buffer each time.
+    bench_run("pcm_f32_to_s16_dither (in place)", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        memcpy(scratch.data(), floats.data(), BENCH_PCM_SAMPLES * sizeof(f32));
+        pcm_f32_to_s16_dither(scratch.data(), reinterpret_cast<i16*>(scratch.data()), BENCH_PCM_SAMPLES, &dither);
+    });
+    bench_run("pcm_s16_to_f32", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        pcm_s16_to_f32(shorts.data(), scratch.data(), BENCH_PCM_SAMPLES);
+    });
+    bench_run("pcm_s16_to_f32_scalar", BENCH_PCM_SAMPLES, BENCH_PCM_RATE, [&]() {
+        pcm_s16_to_f32_scalar(shorts.data(), scratch.data(), BENCH_PCM_SAMPLES);
+    });
+}
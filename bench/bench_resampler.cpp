@@ -0,0 +1,36 @@
+#include "bench.hpp"
+#include <resampler.hpp>
+
+#include <vector>
+#include <cmath>
+
+// Device style use: one 256 frame stereo period at a time, fed the exact input it needs.
+#define BENCH_RESAMPLER_FRAMES 256
+
+static void bench_rate(u32 in_rate, u32 out_rate, u8 quality, const char* quality_name)
+{
+    resampler_t r;
+    if (!resampler_init(&r, in_rate, out_rate, 2, quality, BENCH_RESAMPLER_FRAMES * 4))
+        return;
+
+    std::vector<f32> in(BENCH_RESAMPLER_FRAMES * 4 * 2);
+    std::vector<f32> out(BENCH_RESAMPLER_FRAMES * 2);
+    for (size_t i = 0; i < in.size(); ++i)
+        in[i] = static_cast<f32>(sin(i * 0.01));
+
+    char name[64];
+    snprintf(name, sizeof(name), "resampler %s %u -> %u", quality_name, in_rate, out_rate);
+    bench_run(name, BENCH_RESAMPLER_FRAMES, out_rate, [&]() {
+        u32 needed = resampler_input_needed(&r, BENCH_RESAMPLER_FRAMES);
+        resampler_process(&r, in.data(), needed, out.data(), BENCH_RESAMPLER_FRAMES);
+    });
+}
+
+void bench_resampler()
+{
+    static const u32 rates[][2] = { { 44100, 48000 }, { 22050, 44100 }, { 32000, 48000 }, { 48000, 44100 } };
+    static const char* names[] = { "low", "medium", "high" };
+    for (u8 quality = RESAMPLER_QUALITY_LOW; quality <= RESAMPLER_QUALITY_HIGH; ++quality)
+        for (const auto& rate : rates)
+            bench_rate(rate[0], rate[1], quality, names[quality]);
+}
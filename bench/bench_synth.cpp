@@ -0,0 +1,79 @@
+#include "bench.hpp"
+#include <synth.hpp>
+
+#include <vector>
+#include <cmath>
+
+#define BENCH_SYNTH_FRAMES 256
+#define BENCH_SYNTH_RATE 44100
+
+// The demo's original per-sample sinf() chord, kept as the baseline.
+struct chord_synth_t
+{
+    f32 phase[4];
+    f32 freq[4];
+    f32 sample_rate;
+    f32 lfo_phase[4];
+};
+
+static void chord_callback(i16* samples, i32 frames, void* userdata)
+{
+    const f32 pi = 3.14159265f;
+    chord_synth_t* s = (chord_synth_t*)userdata;
+    const f32 lfo_amount = 0.2f;
+
+    for (i32 i = 0; i < frames; i++)
+    {
+        f32 value = 0.0f;
+        for (i32 n = 0; n < 3; n++)
+        {
+            f32 phase_offset = sinf(s->lfo_phase[n]) * lfo_amount;
+            value += sinf(s->phase[n] + phase_offset);
+
+            s->phase[n] += 2.0f * pi * s->freq[n] / s->sample_rate;
+            if (s->phase[n] > 2.0f * pi)
+                s->phase[n] -= 2.0f * pi;
+        }
+
+        value *= 0.25f;
+
+        i16 sample = (i16)(value * 3000);
+        samples[i * 2 + 0] = sample;
+        samples[i * 2 + 1] = sample;
+    }
+}
+
+static void bench_voices(const char* name, u8 wave, i32 voices)
+{
+    synth_t synth;
+    if (!synth_init(&synth, BENCH_SYNTH_RATE, 2, voices))
+        return;
+
+    synth_patch_t patch;
+    patch.wave = wave;
+    patch.gain = 0.5f / voices;
+    patch.envelope.sustain = 1.0f;
+    patch.lfo_rate = 0.2f;
+    patch.lfo_pitch = 0.05f;
+    for (i32 i = 0; i < voices; ++i)
+        synth_note_on(&synth, patch, 110.0f * powf(2.0f, i / 12.0f), 1.0f);
+
+    std::vector<f32> out(BENCH_SYNTH_FRAMES * 2);
+    bench_run(name, BENCH_SYNTH_FRAMES, BENCH_SYNTH_RATE, [&]() {
+        synth_render(&synth, out.data(), BENCH_SYNTH_FRAMES);
+    });
+    synth_shutdown(&synth);
+}
+
+void bench_synth()
+{
+    chord_synth_t chord{ { 0, 0, 0, 0 }, { 261.63f, 329.63f, 392.00f, 523.25f }, BENCH_SYNTH_RATE, { 0.05f, 0.1f, 0.001f, 0.5f } };
+    std::vector<i16> samples(BENCH_SYNTH_FRAMES * 2);
+    bench_run("synth sinf chord 3 voices", BENCH_SYNTH_FRAMES, BENCH_SYNTH_RATE, [&]() {
+        chord_callback(samples.data(), BENCH_SYNTH_FRAMES, &chord);
+    });
+
+    bench_voices("synth wavetable sine 3 voices", SYNTH_WAVE_SINE, 3);
+    bench_voices("synth wavetable saw 32 voices", SYNTH_WAVE_SAW, 32);
+    bench_voices("synth wavetable square 32 voices", SYNTH_WAVE_SQUARE, 32);
+}
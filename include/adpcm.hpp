@@ -0,0 +1,13 @@
+#pragma once
+
+#include <types.hpp>
+
+// IMA-ADPCM as stored in WAV files (format 0x11): 4 bits per sample, one header
+// per channel per block carrying the predictor and step index, so blocks decode
+// independently.
+
+// Frames held by a block of `block_bytes` bytes, also valid for a short final block.
+u32 ima_adpcm_block_frames(u32 block_bytes, i32 channels);
+
+// Decodes one block into interleaved S16 and returns the frames written, at most `max_frames`.
+u32 ima_adpcm_decode_block(const u8* block, u32 block_bytes, i32 channels, i16* dst, u32 max_frames);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <types.hpp>
+#include <atomic>
+#include <cmath>
+
+// Maps the audio clock (frames rendered since audio started) to get_time().
+// After each period the audio thread reports when the last frame it rendered will
+// reach the DAC; readers on any thread extrapolate from that anchor at the nominal
+// rate. Measurements jitter with the driver's pointer granularity, so the anchor
+// follows them through a one-pole filter. It snaps to the measurement after an xrun
+// (see resync()) or when the two disagree by more than AUDIO_CLOCK_SNAP_SECONDS.
+
+#define AUDIO_CLOCK_SNAP_SECONDS 0.02
+#define AUDIO_CLOCK_SMOOTHING 0.05
+
+// Written by the audio thread only; readers retry around a sequence counter.
+struct audio_clock_t
+{
+	void reset(u32 rate)
+	{
+		sample_rate = rate;
+		rendered = 0;
+		snap = true;
+		publish(0, 0.0);
+	}
+
+	// Frames were dropped or repeated; take the next measurement as is.
+	void resync()
+	{
+		snap = true;
+	}
+
+	// Frames handed to the device since the last update().
+	void advance(u32 frames)
+	{
+		rendered += frames;
+	}
+
+	// `end_time` is when the last frame rendered so far will be heard.
+	void update(f64 end_time)
+	{
+		u64 frame;
+		f64 time;
+		read(&frame, &time);
+		if (!snap)
+		{
+			f64 predicted = time + static_cast<f64>(rendered - frame) / sample_rate;
+			f64 error = end_time - predicted;
+			if (fabs(error) < AUDIO_CLOCK_SNAP_SECONDS)
+				end_time = predicted + error * AUDIO_CLOCK_SMOOTHING;
+		}
+		snap = false;
+		publish(rendered, end_time);
+	}
+
+	// 0 until the first period has been measured.
+	f64 frame_to_time(u64 frame) const
+	{
+		u64 anchor;
+		f64 time;
+		read(&anchor, &time);
+		if (time == 0.0)
+			return 0.0;
+		return time + (static_cast<f64>(frame) - static_cast<f64>(anchor)) / sample_rate;
+	}
+
+	u64 time_to_frame(f64 time) const
+	{
+		u64 anchor;
+		f64 anchor_time;
+		read(&anchor, &anchor_time);
+		if (anchor_time == 0.0)
+			return 0;
+		f64 frame = static_cast<f64>(anchor) + (time - anchor_time) * sample_rate;
+		return frame > 0.0 ? static_cast<u64>(frame) : 0;
+	}
+
+	void publish(u64 frame, f64 time)
+	{
+		u32 seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		anchor_frame.store(frame, std::memory_order_relaxed);
+		anchor_time.store(time, std::memory_order_relaxed);
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	void read(u64* frame, f64* time) const
+	{
+		u32 before, after;
+		do
+		{
+			before = sequence.load(std::memory_order_acquire);
+			*frame = anchor_frame.load(std::memory_order_relaxed);
+			*time = anchor_time.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) || before != after);
+	}
+
+	std::atomic<u32> sequence{ 0 };
+	std::atomic<u64> anchor_frame{ 0 };
+	std::atomic<f64> anchor_time{ 0.0 };
+	u32 sample_rate{ 1 };
+	u64 rendered{ 0 };		// Audio thread only
+	bool snap{ true };
+};
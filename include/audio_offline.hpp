@@ -0,0 +1,24 @@
+#pragma once
+
+#include <device.hpp>
+
+// Offline audio backend. Drives the audio callback of a config_t without a
+// device or display, either as fast as possible or paced at a simulated clock,
+// and optionally writes the output to a WAV file. Runs are deterministic, so
+// they double as synth / mixer benchmarks and regression renders on CI.
+
+struct audio_offline_result_t
+{
+	u64 frames;
+	f64 audio_seconds;
+	f64 wall_seconds;
+	f64 realtime_multiple;		// audio_seconds / wall_seconds
+	audio_stats_t stats;		// Callback timing against the period budget; no xruns offline
+};
+
+// Renders `seconds` of audio in periods of config.audio_frame_count through
+// config.audio_callback_f32 or config.audio_callback. Float callbacks write a float
+// WAV when config.audio_float_output is set, and are converted to S16 otherwise.
+// `clock_rate` 0 renders as fast as possible; otherwise each period is released at
+// clock_rate times real time, e.g. 1.0 to mimic a live device. `wav_path` may be null.
+bool audio_render_offline(const config_t& config, const char* wav_path, f64 seconds, f64 clock_rate, audio_offline_result_t* result);
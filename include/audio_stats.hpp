@@ -0,0 +1,98 @@
+#pragma once
+
+#include <types.hpp>
+#include <atomic>
+
+#define AUDIO_HISTOGRAM_BUCKETS 16
+
+struct audio_stats_t
+{
+	u64 periods;				// Callback invocations
+	u64 xruns;					// Underruns and suspends reported by the driver
+	u64 budget_overruns;		// Callbacks slower than their period
+	f64 period_budget_ms;		// frame_count / sample_rate
+	f64 callback_max_ms;
+	u32 buffer_frames;
+	// Callback durations; bucket i covers [i, i + 1) / 8 of the period budget, the
+	// last bucket also holds everything slower.
+	u32 callback_histogram[AUDIO_HISTOGRAM_BUCKETS];
+	// Output delay samples; bucket i covers [i, i + 1) / AUDIO_HISTOGRAM_BUCKETS of the buffer.
+	u32 delay_histogram[AUDIO_HISTOGRAM_BUCKETS];
+};
+
+// Written by the audio thread only, read from any thread without locks.
+// Single writer, so counters use plain load/store instead of read-modify-write.
+struct audio_telemetry_t
+{
+	void reset(f64 budget_ms, u32 buffer)
+	{
+		periods.store(0, std::memory_order_relaxed);
+		xruns.store(0, std::memory_order_relaxed);
+		budget_overruns.store(0, std::memory_order_relaxed);
+		callback_max_us.store(0, std::memory_order_relaxed);
+		for (u32 i = 0; i < AUDIO_HISTOGRAM_BUCKETS; ++i)
+		{
+			callback_histogram[i].store(0, std::memory_order_relaxed);
+			delay_histogram[i].store(0, std::memory_order_relaxed);
+		}
+		period_budget_ms = budget_ms;
+		buffer_frames = buffer;
+	}
+
+	void record_callback(f64 seconds, f64 budget_seconds)
+	{
+		increment(periods);
+		if (seconds > budget_seconds)
+			increment(budget_overruns);
+
+		u32 us = static_cast<u32>(seconds * 1e6);
+		if (us > callback_max_us.load(std::memory_order_relaxed))
+			callback_max_us.store(us, std::memory_order_relaxed);
+
+		u32 bucket = budget_seconds > 0.0 ? static_cast<u32>(seconds / budget_seconds * 8.0) : 0;
+		increment(callback_histogram[bucket < AUDIO_HISTOGRAM_BUCKETS ? bucket : AUDIO_HISTOGRAM_BUCKETS - 1]);
+	}
+
+	void record_delay(i64 frames)
+	{
+		if (frames < 0 || buffer_frames == 0)
+			return;
+		u64 bucket = static_cast<u64>(frames) * AUDIO_HISTOGRAM_BUCKETS / buffer_frames;
+		increment(delay_histogram[bucket < AUDIO_HISTOGRAM_BUCKETS ? bucket : AUDIO_HISTOGRAM_BUCKETS - 1]);
+	}
+
+	void record_xrun()
+	{
+		increment(xruns);
+	}
+
+	void snapshot(audio_stats_t* stats) const
+	{
+		stats->periods = periods.load(std::memory_order_relaxed);
+		stats->xruns = xruns.load(std::memory_order_relaxed);
+		stats->budget_overruns = budget_overruns.load(std::memory_order_relaxed);
+		stats->period_budget_ms = period_budget_ms;
+		stats->callback_max_ms = callback_max_us.load(std::memory_order_relaxed) * 1e-3;
+		stats->buffer_frames = buffer_frames;
+		for (u32 i = 0; i < AUDIO_HISTOGRAM_BUCKETS; ++i)
+		{
+			stats->callback_histogram[i] = callback_histogram[i].load(std::memory_order_relaxed);
+			stats->delay_histogram[i] = delay_histogram[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	template <typename T>
+	static void increment(std::atomic<T>& counter)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	std::atomic<u64> periods{ 0 };
+	std::atomic<u64> xruns{ 0 };
+	std::atomic<u64> budget_overruns{ 0 };
+	std::atomic<u32> callback_max_us{ 0 };
+	std::atomic<u32> callback_histogram[AUDIO_HISTOGRAM_BUCKETS];
+	std::atomic<u32> delay_histogram[AUDIO_HISTOGRAM_BUCKETS];
+	f64 period_budget_ms{ 0.0 };
+	u32 buffer_frames{ 0 };
+};
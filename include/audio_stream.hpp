@@ -0,0 +1,61 @@
+#pragma once
+
+#include <device.hpp>
+#include <wav.hpp>
+#include <ring.hpp>
+#include <thread>
+#include <atomic>
+
+// Streaming audio source for music and long ambiences.
+// The file stays compressed in a read-only mapping. A decoder thread per stream
+// decodes it a block at a time into a lock-free ring, and a mixer voice reads
+// the ring from the audio thread (see mixer_source_t::stream). Page faults and
+// decoding therefore happen on the decoder thread, never on the audio thread.
+//
+// Supports IMA-ADPCM WAV (about 4:1 against S16) and plain S16 WAV. bench_adpcm
+// decodes a 44.1 kHz stereo track in about 0.03% of an x86 core; the A35 cost has
+// not been measured.
+
+#define AUDIO_STREAM_RING_FRAMES 16384		// ~0.37 s at 44.1 kHz, must be a power of two
+
+struct audio_stream_stats_t
+{
+	u64 frames_decoded;
+	f64 decode_ms;			// Decoder thread time spent decoding, excluding waits
+	u32 underruns;			// Audio thread found the ring short of frames
+};
+
+struct audio_stream_t
+{
+	mapped_file_t file;
+	wav_info_t info;
+	bool loop{ false };
+
+	spsc_buffer_t<i16> ring;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> finished{ false };		// Decoder reached the end without looping
+
+	// Decoder thread side
+	u32 next_block{ 0 };
+	u32 frames_left{ 0 };
+	std::atomic<u64> frames_decoded{ 0 };
+	std::atomic<u64> decode_ns{ 0 };
+	// Audio thread side
+	std::atomic<u32> underruns{ 0 };
+};
+
+// Maps `path` and starts the decoder; the ring is primed before this returns.
+bool audio_stream_open(audio_stream_t* stream, const char* path, bool loop);
+// As above for a WAV image already in memory, which must outlive the stream.
+bool audio_stream_open_memory(audio_stream_t* stream, const u8* data, size_t size, bool loop);
+// Stop the voice playing the stream and wait for mixer_is_playing() to turn false first.
+void audio_stream_close(audio_stream_t* stream);
+void audio_stream_get_stats(const audio_stream_t* stream, audio_stream_stats_t* stats);
+
+// Audio thread: copies up to `frames` frames without consuming them.
+u32 audio_stream_peek(audio_stream_t* stream, i16* samples, u32 frames);
+// Audio thread: consumes frames returned by a previous peek.
+void audio_stream_skip(audio_stream_t* stream, u32 frames);
+// True once the decoder is done and the ring has run dry.
+bool audio_stream_finished(const audio_stream_t* stream);
@@ -6,8 +6,25 @@
 #include <cstring>
 #include <types.hpp>
 #include <math.hpp>
+#include <audio_stats.hpp>
+#include <frame_limiter.hpp>
+#include <frame_stats.hpp>
+#include <input.hpp>
+#include <perf_counters.hpp>
+#include <resampler.hpp>
 #include <glad/glad.h>
 
+struct mixer_t;
+
+// Game thread to audio thread message, see audio_post().
+struct audio_command_t
+{
+	u32 type;
+	u32 target;
+	f32 values[4];
+	void* data;
+};
+
 #define LOG_INFO(fmt, ...) printf("[INFO] " fmt "\n", ##__VA_ARGS__)
 #define LOG_WARN(fmt, ...) printf("[WARN] " fmt "\n", ##__VA_ARGS__)
 #define LOG_ERROR(fmt, ...) printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
@@ -39,23 +56,88 @@
 #define GP_AXIS_RY		0x03
 #define GP_AXIS_COUNT	0x04
 
+#define AUDIO_SCHED_DEFAULT	0x00
+#define AUDIO_SCHED_FIFO	0x01
+#define AUDIO_SCHED_RR		0x02
+
 #define glGenVertexArraysX (glGenVertexArrays ? glGenVertexArrays : glGenVertexArraysOES ? glGenVertexArraysOES : nullptr)
 #define glBindVertexArrayX (glBindVertexArray ? glBindVertexArray : glBindVertexArrayOES ? glBindVertexArrayOES : nullptr)
 #define glDeleteVertexArraysX (glDeleteVertexArrays ? glDeleteVertexArrays : glDeleteVertexArraysOES ? glDeleteVertexArraysOES : nullptr)
 
+// Negotiated output format, see audio_get_info().
+struct audio_info_t
+{
+	u32 sample_rate;
+	i32 channels;
+	i32 period_frames;
+	i32 period_count;
+	i32 buffer_frames;
+	bool mmap;
+	bool float_output;		// Driver takes FLOAT_LE rather than S16_LE
+	bool resampling;		// Callbacks run at config_t::audio_sample_rate and are converted to sample_rate
+};
+
+// Read-only view of a whole file, see map_file().
+struct mapped_file_t
+{
+	const u8* data{ nullptr };
+	size_t size{ 0 };
+	void* handle{ nullptr };		// Platform specific
+};
+
 struct config_t
 {
 	const char* display_title{ "Title" };
 	i32 display_width{ 800 };
 	i32 display_height{ 600 };
 	bool display_vsync{ true };
+	bool display_upload_context{ false };
+	// Frames per second to hold begin_frame() to, 0 for none. Meant for when vsync is off
+	// or the display is faster than the game needs.
+	f64 display_frame_cap{ 0.0 };
+	f64 display_paused_cap{ 10.0 };		// Cap while set_paused(true), 0 to keep display_frame_cap
 
+	const char* audio_device{ "default" };		// ALSA PCM name, e.g. "null" or "file:'out.raw',raw"
+	bool audio_mmap{ true };					// Render into the driver buffer, falls back to writes
 	u32 audio_sample_rate{ 44100 };
 	i32 audio_channels{ 2 };
-	i32 audio_frame_count{ 256 };
+	i32 audio_frame_count{ 256 };				// Period size, ignored when audio_target_latency_ms is set
+	i32 audio_period_count{ 4 };
+	f64 audio_target_latency_ms{ 0.0 };		// Buffer length to aim for, split into audio_period_count periods
+	// When the device cannot run at audio_sample_rate, convert with resampler_t instead of
+	// letting ALSA's plug layer do it. Callbacks always see audio_sample_rate.
+	bool audio_resample{ true };
+	u8 audio_resample_quality{ RESAMPLER_QUALITY_MEDIUM };
 	typedef void (*audio_callback_t)(i16* samples, i32 frames, void* userdata);
 	audio_callback_t audio_callback{ nullptr };
+	// Float samples in [-1, 1], used instead of audio_callback when set. The device
+	// converts to S16 unless the driver accepts float output.
+	typedef void (*audio_callback_f32_t)(f32* samples, i32 frames, void* userdata);
+	audio_callback_f32_t audio_callback_f32{ nullptr };
+	bool audio_float_output{ true };			// Ask the driver for FLOAT_LE before converting here
+	bool audio_dither{ true };					// TPDF dither when converting float to S16
 	void* audio_userdata{ nullptr };
+	// Receives audio_post() commands on the audio thread before each callback.
+	typedef void (*audio_command_callback_t)(const audio_command_t& command, void* userdata);
+	audio_command_callback_t audio_command_callback{ nullptr };
+	// Audio thread scheduling. Falls back to the defaults with a warning when not permitted.
+	u8 audio_thread_policy{ AUDIO_SCHED_DEFAULT };
+	i32 audio_thread_priority{ 50 };		// 1-99 for AUDIO_SCHED_FIFO / AUDIO_SCHED_RR
+	i32 audio_thread_cpu{ -1 };				// Core to pin the audio thread to, -1 for any
+	bool audio_lock_memory{ false };		// mlockall() once the audio buffers exist
+	// Built-in mixer, used when neither callback is set
+	i32 audio_voices{ 32 };
+	i32 audio_buses{ 1 };
+
+	const char* input_device{ nullptr };		// evdev node, e.g. "/dev/input/event2"; found by scanning when null
+	// Read input on its own thread as events arrive instead of once per frame
+	bool input_thread{ false };
+
+	i32 loader_threads{ 2 };
+	f64 loader_upload_budget_ms{ 2.0 };
+
+	// Count cycles, instructions and cache and branch misses per frame, see get_perf_stats()
+	bool perf_counters{ false };
 };
 
 // Device / system management
@@ -66,11 +148,69 @@ void end_frame();
 void close();
 void screen_size(i32* width, i32* height);
 
+// Audio
+mixer_t* get_mixer();
+// Queues a command for config_t::audio_command_callback (single producer, game thread).
+// Returns false when the queue is full.
+bool audio_post(const audio_command_t& command);
+// Xrun counts and callback timing, safe to call from any thread.
+void audio_get_stats(audio_stats_t* stats);
+// What the driver actually granted; false when audio is not running.
+bool audio_get_info(audio_info_t* info);
+// Seconds until the most recently rendered frame is heard.
+f64 audio_output_latency();
+// Audio clock: frames at config_t::audio_sample_rate since audio started. The built-in
+// mixer counts the same frames, so these are the units of mixer_play_at(). Conversions
+// return 0 until the first period has played.
+u64 audio_get_frame();					// Frame reaching the DAC now
+f64 audio_frame_to_time(u64 frame);		// get_time() at which `frame` is heard
+u64 audio_time_to_frame(f64 time);
+
+// Files
+// Maps a file for sequential reading; pages are faulted in on first access by the
+// reading thread. Usable before init().
+bool map_file(const char* path, mapped_file_t* file);
+void unmap_file(mapped_file_t* file);
+
 // Input / timing
+// Both clocks are monotonic and start at init().
+u64 get_time_ns();
 f64 get_time();
-bool is_button_pressed(u8 btn);
+// Percentiles and the worst of the last FRAME_STATS_CAPACITY frames, game thread only.
+void get_frame_stats(frame_stats_t* stats);
+// Drops to config_t::display_paused_cap while the game has nothing to animate.
+void set_paused(bool paused);
+// How closely begin_frame() held the cap, game thread only.
+void get_frame_limiter_stats(frame_limiter_stats_t* stats);
+// Hardware counters of the last frame (config_t::perf_counters), game thread only.
+// All zero when the kernel does not allow them.
+void get_perf_stats(perf_stats_t* stats);
+// Input is sampled in begin_frame(); everything below reflects the latest sample.
+// Picks up input that arrived since the sample, just before it is needed. Edges and
+// events add to the current frame's.
+void input_latch();
+bool is_button_pressed(u8 btn);		// Held down
+bool was_button_pressed(u8 btn);	// Went down since the previous sample
+bool was_button_released(u8 btn);	// Went up since the previous sample
 f32 get_axis_value(u8 axis);
+// Every event of the latest sample in arrival order, with device timestamps.
+const input_event_t* get_input_events(u32* count);
+// Event counts, device-to-game and input-to-photon latency, game thread only.
+void input_get_stats(input_stats_t* stats);
+// Recording saves the events each frame consumes with its frame index. A replay feeds
+// them to the same frames in place of the device, so a fixed timestep run repeats
+// exactly. Game thread only; usable without an input device.
+bool input_record_start(const char* path);
+void input_record_stop();
+bool input_replay_start(const char* path);
+void input_replay_stop();
+bool input_replaying();		// False once a replay went past its last recorded frame
 
 // OpenGL utilities
 GLuint create_program(const char* vsrc, const char* fsrc);
 GLuint create_buffer(GLenum type, GLenum usage, GLsizei size, void* data);
+
+// Shared GL context for background uploads (requires config_t::display_upload_context).
+// Objects created while it is bound are visible to the main context once fenced.
+bool bind_upload_context();
+void unbind_upload_context();
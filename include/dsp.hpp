@@ -0,0 +1,29 @@
+#pragma once
+
+#include <types.hpp>
+
+// Block kernels shared by the mixer, synth and effects, with NEON/SSE2 paths and
+// scalar fallbacks. Buffers are interleaved; gains ramp linearly across the block
+// (g + i * dg at frame i) so parameter changes do not click.
+
+// dst[2i + 0] += src[i] * (l + i * dl), dst[2i + 1] += src[i] * (r + i * dr)
+void dsp_mix_mono_to_stereo(f32* dst, const f32* src, u32 frames, f32 l, f32 r, f32 dl, f32 dr);
+// dst[2i + 0] += src[2i + 0] * (l + i * dl), dst[2i + 1] += src[2i + 1] * (r + i * dr)
+void dsp_mix_stereo_to_stereo(f32* dst, const f32* src, u32 frames, f32 l, f32 r, f32 dl, f32 dr);
+// Mono output only; not a hot path on any supported device.
+void dsp_mix_to_mono(f32* dst, const f32* src, i32 channels, u32 frames, f32 g, f32 dg);
+// dst[i] += src[i] * gain
+void dsp_mix_scaled(f32* dst, const f32* src, u32 count, f32 gain);
+// dst[i] *= src[i]
+void dsp_multiply(f32* dst, const f32* src, u32 count);
+// dst[i] *= gain
+void dsp_scale(f32* dst, u32 count, f32 gain);
+// Stereo interleaved <-> planar, for effects that run one channel at a time.
+void dsp_deinterleave(const f32* src, f32* l, f32* r, u32 frames);
+void dsp_interleave(const f32* l, const f32* r, f32* dst, u32 frames);
+
+// Sets flush-to-zero (and denormals-are-zero on x86) for the calling thread, so decaying
+// filter and reverb tails never hit the slow denormal path. Returns the previous state
+// for dsp_restore_denormals(). Call once at the start of an audio thread.
+u64 dsp_flush_denormals();
+void dsp_restore_denormals(u64 state);
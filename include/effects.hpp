@@ -0,0 +1,124 @@
+#pragma once
+
+#include <types.hpp>
+#include <atomic>
+#include <vector>
+
+// Block effects for mixer buses, see mixer_bus_insert_effect().
+// Effects process planar channels a block at a time so each inner loop walks
+// contiguous arrays: the delay mixes whole runs between its taps with SIMD, the
+// reverb steps its comb filters side by side from arrays of state, and stereo biquads
+// interleave the two channel recursions. Run audio threads with dsp_flush_denormals() so
+// decaying tails stay fast.
+//
+// Every effect times its own blocks; effect_get_stats() can be read from any thread.
+
+#define EFFECT_BIQUAD	0x00
+#define EFFECT_DELAY	0x01
+#define EFFECT_REVERB	0x02
+
+#define EFFECT_BIQUAD_LOWPASS	0x00
+#define EFFECT_BIQUAD_HIGHPASS	0x01
+#define EFFECT_BIQUAD_BANDPASS	0x02
+#define EFFECT_BIQUAD_NOTCH		0x03
+#define EFFECT_BIQUAD_PEAK		0x04
+#define EFFECT_BIQUAD_LOWSHELF	0x05
+#define EFFECT_BIQUAD_HIGHSHELF	0x06
+
+// Parameters for effect_set_param() and mixer_set_effect_param()
+#define EFFECT_BIQUAD_FREQUENCY	0x00	// Hz
+#define EFFECT_BIQUAD_Q			0x01
+#define EFFECT_BIQUAD_GAIN		0x02	// dB, peak and shelf modes only
+#define EFFECT_DELAY_TIME		0x00	// Seconds, up to the maximum given at init
+#define EFFECT_DELAY_FEEDBACK	0x01	// -0.98 to 0.98
+#define EFFECT_DELAY_MIX		0x02	// 0 (dry) to 1 (wet)
+#define EFFECT_REVERB_ROOM		0x00	// 0 to 1
+#define EFFECT_REVERB_DAMPING	0x01	// 0 to 1
+#define EFFECT_REVERB_WIDTH		0x02	// 0 (mono) to 1
+#define EFFECT_REVERB_MIX		0x03	// 0 (dry) to 1 (wet)
+#define EFFECT_PARAM_COUNT		0x04
+
+#define EFFECT_MAX_FRAMES		256		// Frames processed per internal block
+#define EFFECT_REVERB_COMBS		8
+#define EFFECT_REVERB_ALLPASSES	4
+
+struct effect_stats_t
+{
+	u64 blocks;
+	f64 block_avg_us;
+	f64 block_max_us;
+	f64 load;			// Processing time over audio time, 0.01 is 1% of a core
+};
+
+struct effect_delay_line_t
+{
+	std::vector<f32> buffer;
+	u32 position{ 0 };
+};
+
+// Transposed direct form II, one state pair per channel.
+struct effect_biquad_t
+{
+	f32 b0{ 1.0f }, b1{ 0.0f }, b2{ 0.0f }, a1{ 0.0f }, a2{ 0.0f };
+	f32 z1[2]{};
+	f32 z2[2]{};
+};
+
+struct effect_delay_t
+{
+	effect_delay_line_t lines[2];
+	u32 frames{ 1 };
+	u32 max_frames{ 1 };
+};
+
+// Freeverb: eight parallel low-passed combs into four series allpasses per channel.
+struct effect_reverb_t
+{
+	effect_delay_line_t combs[2][EFFECT_REVERB_COMBS];
+	f32 comb_store[2][EFFECT_REVERB_COMBS]{};
+	effect_delay_line_t allpasses[2][EFFECT_REVERB_ALLPASSES];
+	f32 feedback{ 0.0f };
+	f32 damp{ 0.0f };
+	f32 wet1{ 0.0f };
+	f32 wet2{ 0.0f };
+	f32 dry{ 1.0f };
+	std::vector<f32> scratch;		// Input and one wet buffer per channel
+};
+
+struct effect_t
+{
+	u8 type{ EFFECT_BIQUAD };
+	u8 mode{ EFFECT_BIQUAD_LOWPASS };
+	u32 sample_rate{ 0 };
+	i32 channels{ 0 };
+	f32 params[EFFECT_PARAM_COUNT]{};
+
+	effect_biquad_t biquad;
+	effect_delay_t delay;
+	effect_reverb_t reverb;
+
+	// Set while a mixer bus may still run the effect, see mixer_bus_remove_effect().
+	std::atomic<bool> attached{ false };
+
+	// Written by the processing thread only
+	std::atomic<u64> blocks{ 0 };
+	std::atomic<u64> frames{ 0 };
+	std::atomic<u64> total_ns{ 0 };
+	std::atomic<u32> max_ns{ 0 };
+};
+
+// All buffers are allocated here; processing never allocates.
+bool effect_init_biquad(effect_t* effect, u32 sample_rate, i32 channels, u8 mode, f32 frequency, f32 q, f32 gain_db);
+bool effect_init_delay(effect_t* effect, u32 sample_rate, i32 channels, f32 max_seconds, f32 seconds, f32 feedback, f32 mix);
+bool effect_init_reverb(effect_t* effect, u32 sample_rate, i32 channels, f32 room, f32 damping, f32 width, f32 mix);
+void effect_shutdown(effect_t* effect);
+
+// Clears delay lines and filter state.
+void effect_reset(effect_t* effect);
+// Only while the effect is not attached to a mixer; use mixer_set_effect_param() otherwise.
+void effect_set_param(effect_t* effect, u32 param, f32 value);
+// Processes `frames` samples of each of `channels` planar buffers in place.
+void effect_process(effect_t* effect, f32* const* channels, u32 frames);
+
+bool effect_attached(const effect_t* effect);
+void effect_get_stats(const effect_t* effect, effect_stats_t* stats);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <types.hpp>
+
+// Frame rate cap for when the display does not pace frames on its own, and for
+// running slowly while the game is paused. The backend sleeps until spin_ns before
+// each deadline and spins the rest: sleeps overshoot by the scheduler's wakeup
+// latency, but spinning through a whole frame would waste the power the cap saves.
+// Deadlines advance by whole intervals, so one late frame does not delay the rest.
+
+struct frame_limiter_stats_t
+{
+	u64 frames;				// Frames that waited for the cap
+	u64 missed;				// Frames that were already past their deadline
+	f64 interval_ms;		// Current target, 0 when uncapped
+	f64 jitter_avg_us;		// Distance between the deadline and the actual wakeup
+	f64 jitter_max_us;
+	f64 spin_avg_us;		// Time spun after the sleep
+};
+
+// Game thread only.
+struct frame_limiter_t
+{
+	void reset(f64 cap_hz, f64 paused_hz, u64 spin)
+	{
+		interval_ns = cap_hz > 0.0 ? static_cast<u64>(1e9 / cap_hz + 0.5) : 0;
+		paused_interval_ns = paused_hz > 0.0 ? static_cast<u64>(1e9 / paused_hz + 0.5) : 0;
+		spin_ns = spin;
+		paused = false;
+		deadline_ns = 0;
+		frames = 0;
+		missed = 0;
+		jitter_total_ns = 0;
+		jitter_max_ns = 0;
+		spin_total_ns = 0;
+	}
+
+	void set_paused(bool pause)
+	{
+		paused = pause;
+		deadline_ns = 0;
+	}
+
+	u64 interval() const
+	{
+		return paused && paused_interval_ns > 0 ? paused_interval_ns : interval_ns;
+	}
+
+	// When the frame starting now may begin, or 0 to start right away.
+	u64 next_deadline(u64 now_ns)
+	{
+		u64 step = interval();
+		if (step == 0)
+			return 0;
+
+		// Resynchronize after a stall, or the frames after it would run back to back.
+		deadline_ns += step;
+		if (deadline_ns + step < now_ns || deadline_ns > now_ns + step)
+			deadline_ns = now_ns;
+		if (deadline_ns <= now_ns)
+		{
+			if (deadline_ns < now_ns)
+				missed++;
+			return 0;
+		}
+		return deadline_ns;
+	}
+
+	void record(u64 deadline, u64 woke_ns, u64 spun_ns)
+	{
+		u64 jitter = woke_ns > deadline ? woke_ns - deadline : deadline - woke_ns;
+		frames++;
+		jitter_total_ns += jitter;
+		spin_total_ns += spun_ns;
+		if (jitter > jitter_max_ns)
+			jitter_max_ns = jitter;
+	}
+
+	void get_stats(frame_limiter_stats_t* stats) const
+	{
+		stats->frames = frames;
+		stats->missed = missed;
+		stats->interval_ms = interval() * 1e-6;
+		stats->jitter_avg_us = frames > 0 ? jitter_total_ns * 1e-3 / frames : 0.0;
+		stats->jitter_max_us = jitter_max_ns * 1e-3;
+		stats->spin_avg_us = frames > 0 ? spin_total_ns * 1e-3 / frames : 0.0;
+	}
+
+	u64 interval_ns{ 0 };
+	u64 paused_interval_ns{ 0 };
+	u64 spin_ns{ 0 };
+	bool paused{ false };
+	u64 deadline_ns{ 0 };
+
+	u64 frames{ 0 };
+	u64 missed{ 0 };
+	u64 jitter_total_ns{ 0 };
+	u64 jitter_max_ns{ 0 };
+	u64 spin_total_ns{ 0 };
+};
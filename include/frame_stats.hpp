@@ -0,0 +1,44 @@
+#pragma once
+
+#include <types.hpp>
+
+// Per-frame timings kept in a ring, so percentiles and the worst frame can be
+// read back instead of an average that hides hitches.
+#define FRAME_STATS_CAPACITY	256		// Frames kept, a power of two
+#define FRAME_GPU_QUERIES		4		// Timer queries in flight; GPU times arrive this many frames late
+
+struct frame_timing_t
+{
+	u64 index;
+	u64 frame_ns;		// begin_frame() to the next begin_frame()
+	u64 cpu_ns;			// begin_frame() to end_frame(), the frame's own work
+	u64 present_ns;		// Waiting in end_frame() for the swap or page flip
+	u64 gpu_ns;			// GL commands between begin_frame() and end_frame(), 0 until known
+};
+
+struct frame_percentiles_t
+{
+	f64 avg_ms;
+	f64 p50_ms;
+	f64 p95_ms;
+	f64 p99_ms;
+	f64 max_ms;
+};
+
+struct frame_stats_t
+{
+	u32 frames;					// Frames behind the figures, up to FRAME_STATS_CAPACITY
+	frame_percentiles_t frame;
+	frame_percentiles_t cpu;
+	frame_percentiles_t present;
+	frame_percentiles_t gpu;	// Zero without timer queries
+	frame_timing_t worst;		// Longest frame of the window
+	bool gpu_timing;
+};
+
+// Backend side, game thread with the GL context current.
+void frame_stats_init();
+void frame_stats_shutdown();
+void frame_stats_begin(u64 now_ns);		// Entering begin_frame()
+void frame_stats_present(u64 now_ns);	// Entering end_frame(), before the swap
+void frame_stats_end(u64 now_ns);		// Leaving end_frame()
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <types.hpp>
+
+// Frame input state shared by the backends.
+// A backend reads device events in batches and queues them with their kernel
+// timestamps; once per frame input_queue_update() applies them in order, so a press
+// and release inside one frame still produce both edges, and the frame's events stay
+// available as a stream through get_input_events().
+//
+// The producer also publishes the latest levels under a sequence lock. The game
+// thread falls back to them when the queue overflowed, so a lost release never
+// leaves a button stuck.
+
+#define INPUT_EVENT_BUTTON		0x00
+#define INPUT_EVENT_AXIS		0x01
+
+#define INPUT_EVENT_CAPACITY	256		// Events kept per frame, and queued between frames
+#define INPUT_HISTOGRAM_BUCKETS	16
+#define INPUT_HISTOGRAM_MS		2.0		// Width of one latency bucket
+
+struct input_event_t
+{
+	f64 time;		// When the device reported it, on the get_time() clock
+	u8 type;		// INPUT_EVENT_BUTTON or INPUT_EVENT_AXIS
+	u8 control;		// GP_BTN_* or GP_AXIS_*
+	f32 value;		// 0 or 1 for buttons, -1 to 1 for axes
+};
+
+struct input_stats_t
+{
+	u64 events;
+	u64 dropped;				// Lost to a full queue or a kernel buffer overrun
+	f64 latency_avg_ms;			// Event timestamp to the frame that consumed it
+	f64 latency_max_ms;
+	// Bucket i covers [i, i + 1) * INPUT_HISTOGRAM_MS, the last also holds everything slower.
+	u32 latency_histogram[INPUT_HISTOGRAM_BUCKETS];
+	// Event timestamp to the present of the frame that consumed it
+	f64 photon_avg_ms;
+	f64 photon_max_ms;
+	u64 latched;				// Events picked up by input_latch() rather than the frame sample
+	f64 latch_saved_avg_ms;		// How much earlier input_latch() saw them than the next frame would have
+};
+
+// Backend side
+void input_queue_reset();
+// Producer: one thread, may differ from the one calling input_queue_update().
+bool input_queue_push(const input_event_t& event);
+void input_queue_dropped(u32 count);
+// Consumer, once per frame: applies queued events and starts a new set of edges.
+void input_queue_update(f64 now);
+// Consumer, mid frame: applies events queued since, adding to the frame's edges.
+void input_queue_latch(f64 now);
+// The frame whose input was consumed since the last call reached the screen at `time`.
+void input_queue_presented(f64 time);
+
+// Device discovery. The backend describes each candidate device in terms of the
+// controls it would map, so choosing one needs no hardware.
+struct input_device_desc_t
+{
+	const char* name;
+	u32 buttons;			// Bit per GP_BTN_* the device reports
+	u32 axes;				// Bit per GP_AXIS_* the device reports
+	u32 keys;				// Keyboard keys it reports
+	bool gamepad;			// Reports a button of the gamepad range (BTN_SOUTH and up)
+	bool accelerometer;		// Motion sensor half of a controller
+};
+
+// Higher is a better gamepad; negative means it is not one.
+i32 input_score_device(const input_device_desc_t& desc);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <types.hpp>
+#include <vector>
+#include <memory>
+
+// Asynchronous asset loading.
+// Files are read and decoded on worker threads; the GPU upload step is queued and
+// run on the GL thread from loader_update() within a per-frame time budget, or on a
+// dedicated thread bound to the shared upload context when background uploads are enabled.
+
+#define LOAD_PENDING	0x00
+#define LOAD_DECODING	0x01
+#define LOAD_UPLOADING	0x02
+#define LOAD_DONE		0x03
+#define LOAD_FAILED		0x04
+#define LOAD_CANCELLED	0x05
+
+struct load_job_t;
+typedef std::shared_ptr<load_job_t> load_handle_t;
+
+struct load_request_t
+{
+	// Read into `data` on a worker before decode. May be null for generated assets.
+	const char* path{ nullptr };
+	// Higher priorities are decoded and uploaded first.
+	i32 priority{ 0 };
+
+	// Worker thread: turn `data` into something uploadable (in place). Return false to fail.
+	typedef bool (*decode_fn_t)(std::vector<u8>& data, void* userdata);
+	// GL or upload thread: create GL objects from the decoded `data`. Return false to fail.
+	typedef bool (*upload_fn_t)(std::vector<u8>& data, void* userdata);
+	// GL thread: called once with the final status (LOAD_DONE, LOAD_FAILED or LOAD_CANCELLED).
+	typedef void (*complete_fn_t)(u8 status, void* userdata);
+
+	decode_fn_t decode{ nullptr };
+	upload_fn_t upload{ nullptr };
+	complete_fn_t complete{ nullptr };
+	void* userdata{ nullptr };
+};
+
+bool loader_init(i32 thread_count, bool background_uploads);
+// Jobs still queued complete as LOAD_FAILED (or LOAD_CANCELLED) before this returns.
+void loader_shutdown();
+
+// Runs queued uploads and completion callbacks until `budget_ms` is spent (GL thread only).
+// At least one upload is processed per call so the queue always drains. With background
+// uploads it only completes jobs whose upload fence has signaled.
+void loader_update(f64 budget_ms);
+
+// Without a running loader the handle comes back LOAD_FAILED, after `complete` has run.
+load_handle_t load_async(const load_request_t& request);
+u8 load_status(const load_handle_t& handle);
+bool load_cancel(const load_handle_t& handle);
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <types.hpp>
+#include <ring.hpp>
+#include <vector>
+#include <memory>
+
+// Software mixer.
+// Voices are resampled into a scratch block, accumulated into a float bus with
+// SIMD gain ramps, run through the bus effect chain, and buses are summed into
+// the output and converted to S16 in a single saturating pass at the end of the period.
+//
+// The voice functions are called from the game thread. They push commands into a
+// lock-free ring that mixer_render() drains at the start of each period, so the
+// audio thread never waits on the game thread.
+
+#define MIXER_BLOCK_FRAMES 256
+#define MIXER_COMMAND_CAPACITY 256
+#define MIXER_BUS_EFFECTS 8
+
+#define MIXER_CMD_PLAY		0x00
+#define MIXER_CMD_STOP		0x01
+#define MIXER_CMD_GAIN		0x02
+#define MIXER_CMD_PAN		0x03
+#define MIXER_CMD_PITCH		0x04
+#define MIXER_CMD_BUS_GAIN	0x05
+#define MIXER_CMD_EFFECT_INSERT	0x06
+#define MIXER_CMD_EFFECT_REMOVE	0x07
+#define MIXER_CMD_EFFECT_PARAM	0x08
+
+struct audio_stream_t;
+struct effect_t;
+
+struct mixer_source_t
+{
+	const i16* samples{ nullptr };	// Interleaved PCM, owned by the caller
+	u32 frames{ 0 };
+	i32 channels{ 1 };				// 1 or 2
+	u32 sample_rate{ 44100 };
+	// Reads frames from a decoder thread instead of `samples`; see mixer_stream_source().
+	// Looping is set on the stream, and only one voice may play a stream at a time.
+	audio_stream_t* stream{ nullptr };
+};
+
+struct mixer_voice_params_t
+{
+	f32 gain{ 1.0f };
+	f32 pan{ 0.0f };		// -1 (left) to 1 (right)
+	f32 pitch{ 1.0f };		// Playback rate multiplier
+	i32 bus{ 0 };
+	i32 priority{ 0 };		// Lower priority voices are stolen first
+	bool loop{ false };
+};
+
+struct mixer_voice_t
+{
+	mixer_source_t source;
+	mixer_voice_params_t params;
+	u32 id{ 0 };			// 0 while the voice is free
+	u64 position{ 0 };		// Source frame in 32.32 fixed point
+	u64 start{ 0 };			// Mixer frame the voice starts on, see mixer_play_at()
+	f32 gain_l{ 0.0f };		// Gains reached at the end of the last block
+	f32 gain_r{ 0.0f };
+};
+
+struct mixer_command_t
+{
+	u8 type;
+	u32 target;				// Voice id, bus index, or parameter for MIXER_CMD_EFFECT_PARAM
+	f32 value;
+	mixer_source_t source;
+	mixer_voice_params_t params;
+	effect_t* effect;
+	u64 frame;				// Start frame for MIXER_CMD_PLAY
+};
+
+struct mixer_bus_t
+{
+	f32 gain{ 1.0f };
+	std::vector<f32> buffer;
+	effect_t* effects[MIXER_BUS_EFFECTS]{};		// Run in order on the bus, audio thread only
+	u32 effect_count{ 0 };
+};
+
+struct mixer_t
+{
+	u32 sample_rate{ 0 };
+	i32 channels{ 0 };
+	std::vector<mixer_voice_t> voices;
+	std::vector<mixer_bus_t> buses;
+	std::vector<f32> scratch;
+	std::vector<i16> stream_scratch;
+	std::vector<f32> planar;		// Deinterleaved bus for the effect chain
+	std::vector<f32> output;
+	u64 clock{ 0 };			// Frames rendered, audio thread only
+
+	// Game thread side
+	u32 next_id{ 1 };
+	spsc_ring_t<mixer_command_t, MIXER_COMMAND_CAPACITY> commands;
+	// Published by the audio thread for mixer_is_playing()
+	std::unique_ptr<std::atomic<u32>[]> playing;
+	std::atomic<u32> started_id{ 0 };
+};
+
+// Sizes every buffer up front; rendering never allocates for up to `max_frames` per call.
+bool mixer_init(mixer_t* mixer, u32 sample_rate, i32 channels, i32 max_frames, i32 max_voices, i32 bus_count);
+void mixer_shutdown(mixer_t* mixer);
+
+// Source for a stream opened with audio_stream_open().
+mixer_source_t mixer_stream_source(audio_stream_t* stream);
+
+// Returns a voice id, or 0 when the command ring is full. The sound is dropped when
+// the audio thread finds every voice busy with a higher priority sound.
+u32 mixer_play(mixer_t* mixer, const mixer_source_t& source, const mixer_voice_params_t& params);
+// Starts the sound on mixer frame `frame`, exact to the sample within whichever period
+// contains it; frames already rendered start at once. The device mixer counts audio
+// clock frames, so audio_time_to_frame() converts a get_time() target. The voice is
+// taken when the command is read, so schedule no further ahead than voices allow.
+u32 mixer_play_at(mixer_t* mixer, const mixer_source_t& source, const mixer_voice_params_t& params, u64 frame);
+void mixer_stop(mixer_t* mixer, u32 voice);
+// True until the voice stops; a voice that is still queued counts as playing.
+bool mixer_is_playing(const mixer_t* mixer, u32 voice);
+void mixer_set_gain(mixer_t* mixer, u32 voice, f32 gain);
+void mixer_set_pan(mixer_t* mixer, u32 voice, f32 pan);
+void mixer_set_pitch(mixer_t* mixer, u32 voice, f32 pitch);
+void mixer_set_bus_gain(mixer_t* mixer, i32 bus, f32 gain);
+
+// Appends an effect from effects.hpp to the end of a bus chain. The effect must match
+// the mixer rate and channel count and stays owned by the caller: after
+// mixer_bus_remove_effect(), keep it alive until effect_attached() returns false.
+bool mixer_bus_insert_effect(mixer_t* mixer, i32 bus, effect_t* effect);
+void mixer_bus_remove_effect(mixer_t* mixer, effect_t* effect);
+void mixer_set_effect_param(mixer_t* mixer, effect_t* effect, u32 param, f32 value);
+
+// Audio thread only
+void mixer_render_f32(mixer_t* mixer, f32* samples, i32 frames);
+void mixer_render(mixer_t* mixer, i16* samples, i32 frames);
+
+// Match config_t::audio_callback_t and config_t::audio_callback_f32_t with the mixer as userdata.
+void mixer_audio_callback(i16* samples, i32 frames, void* userdata);
+void mixer_audio_callback_f32(f32* samples, i32 frames, void* userdata);
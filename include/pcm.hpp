@@ -0,0 +1,25 @@
+#pragma once
+
+#include <types.hpp>
+
+// Sample format conversion kernels. Counts are in samples (frames * channels).
+// Float samples use the [-1, 1] range. Each kernel has a NEON and an SSE2 path,
+// and a scalar fallback that produces identical results: every path rounds to
+// nearest with ties to even, like lrintf().
+
+// Per-lane xorshift state for the dithering kernels.
+struct pcm_dither_t
+{
+	u32 state[4]{ 0x12345678u, 0x9E3779B9u, 0x85EBCA6Bu, 0xC2B2AE35u };
+};
+
+// Clamps to [-1, 1] and rounds to the nearest S16 value. `dst` may alias `src`.
+void pcm_f32_to_s16(const f32* src, i16* dst, u32 count);
+// As above with +-1 LSB triangular (TPDF) dither. `dst` may alias `src`.
+void pcm_f32_to_s16_dither(const f32* src, i16* dst, u32 count, pcm_dither_t* dither);
+void pcm_s16_to_f32(const i16* src, f32* dst, u32 count);
+
+// Scalar versions of the kernels above, for benchmarks and validation.
+void pcm_f32_to_s16_scalar(const f32* src, i16* dst, u32 count);
+void pcm_f32_to_s16_dither_scalar(const f32* src, i16* dst, u32 count, pcm_dither_t* dither);
+void pcm_s16_to_f32_scalar(const i16* src, f32* dst, u32 count);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <types.hpp>
+
+// Hardware performance counters per frame, through perf_event_open() on Linux. Each
+// counted thread gets one event group, so its counters run together and are read
+// with one syscall. Only user space is counted, which perf_event_paranoid 2 allows.
+// When the kernel refuses or has no PMU driver, and on other platforms, nothing is
+// opened and every sample reads as zero with an empty mask.
+#define PERF_COUNTER_CYCLES			0
+#define PERF_COUNTER_INSTRUCTIONS	1
+#define PERF_COUNTER_L1D_MISSES		2		// L1 data cache read misses
+#define PERF_COUNTER_LLC_MISSES		3		// Last level cache read misses
+#define PERF_COUNTER_BRANCH_MISSES	4
+#define PERF_COUNTER_COUNT			5
+
+#define PERF_THREAD_MAIN	0
+#define PERF_THREAD_AUDIO	1
+#define PERF_THREAD_COUNT	2
+
+struct perf_sample_t
+{
+	u32 mask;							// 1 << PERF_COUNTER_* for each counter the kernel opened
+	bool multiplexed;					// The group shared the PMU, so values are scaled estimates
+	u64 values[PERF_COUNTER_COUNT];
+};
+
+struct perf_stats_t
+{
+	perf_sample_t main;		// Game thread, begin_frame() to end_frame() of the last frame
+	perf_sample_t audio;	// Audio thread, between the last two end_frame() calls
+};
+
+// Backend hooks. init counts the calling thread as PERF_THREAD_MAIN; attach is called
+// on other threads as they start. begin and end run on the game thread, and read the
+// other threads' groups too, so those threads pay nothing per frame.
+bool perf_counters_init(bool enabled);
+void perf_counters_shutdown();			// After the attached threads have exited
+void perf_counters_attach(u32 thread);
+void perf_counters_begin();
+void perf_counters_end();
+void perf_counters_get(perf_stats_t* stats);
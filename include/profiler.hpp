@@ -0,0 +1,43 @@
+#pragma once
+
+#include <device.hpp>
+
+// Scoped CPU profiler. PROFILE_SCOPE("name") records when the enclosing scope starts
+// and ends into the calling thread's own ring, without locks or allocation, and
+// profile_dump() writes every ring as Chrome trace JSON for chrome://tracing or
+// ui.perfetto.dev. Recording is built only with GAME_PROFILE defined (the CMake
+// option of the same name); otherwise the macros expand to nothing.
+#define PROFILE_THREADS		16		// Threads that can record; later ones are ignored
+#define PROFILE_EVENTS		4096	// Scopes kept per thread, a power of two
+
+#if defined(GAME_PROFILE)
+
+// Names are stored by pointer, so they must outlive the dump; use string literals.
+void profile_thread_name(const char* name);
+void profile_record(const char* name, u64 begin_ns, u64 end_ns);
+
+struct profile_scope_t
+{
+	explicit profile_scope_t(const char* scope_name) : name(scope_name), begin_ns(get_time_ns()) {}
+	~profile_scope_t() { profile_record(name, begin_ns, get_time_ns()); }
+
+	const char* name;
+	u64 begin_ns;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) profile_scope_t PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_THREAD(name) profile_thread_name(name)
+
+#else
+
+#define PROFILE_SCOPE(name) do {} while (0)
+#define PROFILE_THREAD(name) do {} while (0)
+
+#endif
+
+// Writes the scopes still in the rings, any thread. Scopes a thread records while the
+// dump runs may be left out. False when the file cannot be written, or when profiling
+// is compiled out.
+bool profile_dump(const char* path);
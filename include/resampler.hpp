@@ -0,0 +1,54 @@
+#pragma once
+
+#include <types.hpp>
+#include <vector>
+
+// Polyphase windowed-sinc sample-rate converter for fixed rate pairs, e.g. assets
+// at 22.05 / 32 / 48 kHz played on a 44.1 kHz device, or a device that granted a
+// different rate than requested. The ratio is reduced to L / M and every one of
+// the L phases gets its own Kaiser-windowed sinc, so conversion is exact for any
+// integer rates. Cost per output frame is `taps` multiply-adds per channel, see
+// bench_resampler.cpp for the measured numbers on each quality level.
+
+// SNR figures are for in-band tones; the passband is a fraction of the lower Nyquist frequency.
+#define RESAMPLER_QUALITY_LOW		0x00	// 8 taps, ~50 dB SNR, passband 0.85
+#define RESAMPLER_QUALITY_MEDIUM	0x01	// 16 taps, ~70 dB SNR, passband 0.9
+#define RESAMPLER_QUALITY_HIGH		0x02	// 32 taps, ~95 dB SNR, passband 0.94
+
+#define RESAMPLER_MAX_PHASES 1024
+
+struct resampler_t
+{
+	u32 in_rate{ 0 };
+	u32 out_rate{ 0 };
+	u32 phases{ 0 };			// L: output positions per input frame, after reduction
+	u32 step_int{ 0 };			// M / L
+	u32 step_frac{ 0 };			// M % L
+	i32 channels{ 0 };
+	u32 taps{ 0 };
+	std::vector<f32> coeffs;	// phases x taps
+
+	// Input history followed by the frames appended by the latest call
+	std::vector<f32> buffer;
+	u32 capacity{ 0 };			// Frames
+	u32 buffered{ 0 };
+	u32 position{ 0 };			// Frame in `buffer` the next output filter starts at
+	u32 phase{ 0 };
+};
+
+// `max_input_frames` bounds the input of a single resampler_process() call, which
+// then never allocates. Fails when the reduced ratio needs more than
+// RESAMPLER_MAX_PHASES phases.
+bool resampler_init(resampler_t* resampler, u32 in_rate, u32 out_rate, i32 channels, u8 quality, u32 max_input_frames);
+// Clears the history, as at init.
+void resampler_reset(resampler_t* resampler);
+
+// Input frames the next call needs to produce exactly `out_frames` frames.
+u32 resampler_input_needed(const resampler_t* resampler, u32 out_frames);
+// Appends `in_frames` interleaved frames and writes up to `max_out` frames to `out`.
+// Returns the frames written; input that is not used yet stays for the next call.
+u32 resampler_process(resampler_t* resampler, const f32* in, u32 in_frames, f32* out, u32 max_out);
+
+// One-shot conversion for assets at load time. The output is aligned with the
+// input and ceil(frames * dst_rate / src_rate) frames long.
+bool resample_s16(const i16* src, u32 frames, i32 channels, u32 src_rate, u32 dst_rate, u8 quality, std::vector<i16>* dst);
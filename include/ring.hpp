@@ -0,0 +1,115 @@
+#pragma once
+
+#include <types.hpp>
+#include <atomic>
+#include <memory>
+
+// Bounded single-producer, single-consumer ring buffer.
+// push() may only be called from one thread and pop() from one other thread.
+// Neither side locks or allocates, so it is safe to use from the audio thread.
+template <typename T, u32 CAPACITY>
+struct spsc_ring_t
+{
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Ring capacity must be a power of two");
+
+	bool push(const T& item)
+	{
+		u32 tail = write_index.load(std::memory_order_relaxed);
+		if (tail - read_index.load(std::memory_order_acquire) == CAPACITY)
+			return false;
+
+		items[tail & (CAPACITY - 1)] = item;
+		write_index.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T* item)
+	{
+		u32 head = read_index.load(std::memory_order_relaxed);
+		if (head == write_index.load(std::memory_order_acquire))
+			return false;
+
+		*item = items[head & (CAPACITY - 1)];
+		read_index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	u32 size() const
+	{
+		return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+	}
+
+	// Each index lives on its own cache line so producer and consumer do not false share.
+	alignas(64) std::atomic<u32> write_index{ 0 };
+	alignas(64) std::atomic<u32> read_index{ 0 };
+	alignas(64) T items[CAPACITY];
+};
+
+// Bulk single-producer, single-consumer sample buffer with a capacity chosen at
+// init time. The consumer can peek at samples before consuming them, which lets a
+// reader keep interpolation taps in place across calls.
+template <typename T>
+struct spsc_buffer_t
+{
+	// `capacity` must be a power of two. Not thread safe; call before either side runs.
+	void init(u32 capacity)
+	{
+		items.reset(new T[capacity]);
+		mask = capacity - 1;
+		write_index.store(0, std::memory_order_relaxed);
+		read_index.store(0, std::memory_order_relaxed);
+	}
+
+	u32 capacity() const
+	{
+		return mask + 1;
+	}
+
+	// Producer side: copies up to `count` items and returns how many fit.
+	u32 write(const T* src, u32 count)
+	{
+		u32 tail = write_index.load(std::memory_order_relaxed);
+		u32 space = capacity() - (tail - read_index.load(std::memory_order_acquire));
+		if (count > space)
+			count = space;
+
+		for (u32 i = 0; i < count; ++i)
+			items[(tail + i) & mask] = src[i];
+		write_index.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	u32 writable() const
+	{
+		return capacity() - (write_index.load(std::memory_order_relaxed) - read_index.load(std::memory_order_acquire));
+	}
+
+	// Consumer side: copies up to `count` items without consuming them.
+	u32 peek(T* dst, u32 count) const
+	{
+		u32 head = read_index.load(std::memory_order_relaxed);
+		u32 available = write_index.load(std::memory_order_acquire) - head;
+		if (count > available)
+			count = available;
+
+		for (u32 i = 0; i < count; ++i)
+			dst[i] = items[(head + i) & mask];
+		return count;
+	}
+
+	// Consumer side: drops `count` items, which must not exceed readable().
+	void skip(u32 count)
+	{
+		read_index.store(read_index.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+
+	u32 readable() const
+	{
+		return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_relaxed);
+	}
+
+	alignas(64) std::atomic<u32> write_index{ 0 };
+	alignas(64) std::atomic<u32> read_index{ 0 };
+	alignas(64) std::unique_ptr<T[]> items;
+	u32 mask{ 0 };
+};
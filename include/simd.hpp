@@ -0,0 +1,11 @@
+#pragma once
+
+// Picks the vector instruction set for the audio kernels.
+// Every kernel keeps a scalar path for targets where neither is defined.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <types.hpp>
+#include <vector>
+
+// Polyphonic synth for procedural audio.
+// Oscillators read band-limited wavetables with linear interpolation; every wave
+// has one table per octave so high notes do not alias. Pitch, LFOs and gains are
+// updated once per SYNTH_BLOCK_FRAMES block and ramped across it, envelopes are
+// rendered a segment at a time, and the per-sample work left is one table lookup
+// per voice plus the SIMD block kernels from dsp.hpp.
+//
+// Not thread safe: call everything from the audio thread, e.g. from
+// config_t::audio_command_callback, or before audio starts.
+
+#define SYNTH_WAVE_SINE		0x00
+#define SYNTH_WAVE_TRIANGLE	0x01
+#define SYNTH_WAVE_SAW		0x02
+#define SYNTH_WAVE_SQUARE	0x03
+#define SYNTH_WAVE_COUNT	0x04
+
+#define SYNTH_TABLE_BITS	10
+#define SYNTH_TABLE_SIZE	(1 << SYNTH_TABLE_BITS)
+#define SYNTH_TABLE_LEVELS	9		// Level n holds up to 256 >> n harmonics
+#define SYNTH_BLOCK_FRAMES	64
+
+struct synth_adsr_t
+{
+	f32 attack{ 0.01f };	// Seconds
+	f32 decay{ 0.1f };
+	f32 sustain{ 0.8f };	// Level
+	f32 release{ 0.2f };
+};
+
+struct synth_patch_t
+{
+	u8 wave{ SYNTH_WAVE_SINE };
+	f32 gain{ 0.25f };
+	f32 pan{ 0.0f };		// -1 (left) to 1 (right)
+	synth_adsr_t envelope;
+	f32 lfo_rate{ 0.0f };	// Hz
+	f32 lfo_phase{ 0.0f };	// Starting phase in cycles, 0..1
+	f32 lfo_pitch{ 0.0f };	// Vibrato depth in semitones
+	f32 lfo_gain{ 0.0f };	// Tremolo depth, 0..1
+};
+
+struct synth_voice_t
+{
+	synth_patch_t patch;
+	u32 id{ 0 };			// 0 while the voice is free
+	f32 frequency{ 0.0f };
+	f32 velocity{ 0.0f };
+	u32 phase{ 0 };			// Oscillator phase, a full cycle per 2^32
+	u32 lfo_phase{ 0 };
+	u8 stage{ 0 };
+	f32 level{ 0.0f };		// Envelope level at the end of the last block
+	f32 release_slope{ 0.0f };
+	f32 pan_l{ 1.0f };		// Constant power pan, fixed at note on
+	f32 pan_r{ 1.0f };
+	f32 gain_l{ 0.0f };		// Gains reached at the end of the last block
+	f32 gain_r{ 0.0f };
+};
+
+struct synth_t
+{
+	u32 sample_rate{ 0 };
+	i32 channels{ 0 };
+	std::vector<synth_voice_t> voices;
+	std::vector<f32> oscillator;
+	std::vector<f32> envelope;
+	u32 next_id{ 1 };
+};
+
+// Builds the shared wavetables on first use.
+bool synth_init(synth_t* synth, u32 sample_rate, i32 channels, i32 max_voices);
+void synth_shutdown(synth_t* synth);
+
+// Returns a voice id. Steals the quietest releasing voice, or the oldest, when all are busy.
+u32 synth_note_on(synth_t* synth, const synth_patch_t& patch, f32 frequency, f32 velocity);
+// Starts the release stage; the voice frees itself once silent.
+void synth_note_off(synth_t* synth, u32 voice);
+void synth_set_frequency(synth_t* synth, u32 voice, f32 frequency);
+bool synth_is_playing(const synth_t* synth, u32 voice);
+
+// Overwrites `frames` interleaved frames.
+void synth_render(synth_t* synth, f32* samples, i32 frames);
+
+// Matches config_t::audio_callback_f32_t with the synth as userdata.
+void synth_audio_callback_f32(f32* samples, i32 frames, void* userdata);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <types.hpp>
+
+// Fixed timestep driver. Frame time goes into an accumulator that the simulation
+// drains in steps of exactly step_ns, so its cost and results per second do not
+// depend on the frame rate. Rendering gets the leftover as an interpolation alpha
+// between the last two simulated states.
+
+typedef void (*timestep_tick_t)(f64 dt, u64 tick, void* userdata);
+typedef void (*timestep_render_t)(f32 alpha, void* userdata);
+
+struct timestep_t
+{
+	u64 step_ns;
+	u32 max_steps;			// Catch-up limit per frame; time beyond it is dropped
+	// One step per frame regardless of the clock, for input replays and benchmarks
+	// that have to repeat exactly.
+	bool lockstep;
+
+	u64 accumulator_ns;
+	u64 last_ns;
+	u64 ticks;				// Steps simulated so far
+	u64 dropped_ns;			// Time discarded by the catch-up limit
+	f32 alpha;				// accumulator_ns / step_ns after the latest frame
+	bool started;
+};
+
+void timestep_init(timestep_t* timestep, f64 rate_hz, u32 max_steps);
+// Adds the time since the previous call and returns how many steps to run now.
+u32 timestep_advance(timestep_t* timestep, u64 now_ns);
+// timestep_advance(), then `tick` once per step and `render` once with the alpha.
+void timestep_run(timestep_t* timestep, u64 now_ns, timestep_tick_t tick, timestep_render_t render, void* userdata);
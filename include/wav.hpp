@@ -0,0 +1,40 @@
+#pragma once
+
+#include <types.hpp>
+#include <cstdio>
+
+#define WAV_FORMAT_PCM			0x0001
+#define WAV_FORMAT_IEEE_FLOAT	0x0003
+#define WAV_FORMAT_IMA_ADPCM	0x0011
+
+// Layout of a RIFF/WAVE file held in memory. `data` points into the caller's buffer.
+struct wav_info_t
+{
+	u16 format;
+	i32 channels;
+	u32 sample_rate;
+	u32 block_align;			// Bytes per ADPCM block, or per frame for PCM
+	u32 frames_per_block;		// 1 for PCM
+	u32 frames;
+	const u8* data;
+	u32 data_bytes;
+};
+
+bool wav_parse(const u8* file, size_t size, wav_info_t* info);
+
+// Streams interleaved samples to a RIFF/WAVE file. The chunk sizes are
+// patched in by wav_close(), so the file is only valid once closed.
+struct wav_writer_t
+{
+	FILE* file{ nullptr };
+	u16 format{ WAV_FORMAT_PCM };
+	u32 sample_rate{ 0 };
+	i32 channels{ 0 };
+	u32 data_bytes{ 0 };
+};
+
+// `format` is WAV_FORMAT_PCM for S16 samples or WAV_FORMAT_IEEE_FLOAT for f32 samples.
+// Samples are passed in host order and written little endian.
+bool wav_open(wav_writer_t* writer, const char* path, u32 sample_rate, i32 channels, u16 format);
+bool wav_write(wav_writer_t* writer, const void* samples, u32 frames);
+void wav_close(wav_writer_t* writer);
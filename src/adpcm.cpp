@@ -0,0 +1,122 @@
+#include <adpcm.hpp>
+
+#include <algorithm>
+
+static const i16 IMA_STEP_TABLE[89] =
+{
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const i8 IMA_INDEX_TABLE[16] =
+{
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+struct ima_channel_t
+{
+    i32 predictor;
+    i32 index;
+};
+
+// Reference shift-and-add form, so output matches other IMA decoders bit for bit.
+// The bit tests are turned into masks because the nibbles are effectively random.
+static inline i16 ima_decode_nibble(i32& predictor, i32& index, u32 nibble)
+{
+    i32 step = IMA_STEP_TABLE[index];
+    i32 diff = step >> 3;
+    diff += (step >> 2) & -static_cast<i32>(nibble & 1);
+    diff += (step >> 1) & -static_cast<i32>((nibble >> 1) & 1);
+    diff += step & -static_cast<i32>((nibble >> 2) & 1);
+    i32 sign = -static_cast<i32>((nibble >> 3) & 1);
+    diff = (diff ^ sign) - sign;
+
+    predictor = std::max(-32768, std::min(32767, predictor + diff));
+    index = std::max(0, std::min(88, index + IMA_INDEX_TABLE[nibble]));
+    return static_cast<i16>(predictor);
+}
+
+static inline u32 read_word(const u8* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<u32>(p[3]) << 24;
+}
+
+// Each channel stores 8 samples per 4 byte word, low nibble first; words alternate
+// between channels. The state lives in locals: `data` is a byte pointer, which the
+// compiler must otherwise assume aliases it.
+static void ima_decode_mono(ima_channel_t* state, const u8* data, i16* dst, u32 frames)
+{
+    i32 p = state->predictor, index = state->index;
+    for (u32 frame = 0; frame < frames; frame += 8, data += 4)
+    {
+        u32 count = frames - frame < 8 ? frames - frame : 8;
+        u32 word = read_word(data);
+        for (u32 i = 0; i < count; ++i, word >>= 4)
+            dst[frame + i] = ima_decode_nibble(p, index, word & 0xF);
+    }
+}
+
+// The two channels are independent dependency chains, decoded in lockstep so the
+// CPU can overlap them.
+static void ima_decode_stereo(ima_channel_t* state, const u8* data, i16* dst, u32 frames)
+{
+    i32 p0 = state[0].predictor, index0 = state[0].index;
+    i32 p1 = state[1].predictor, index1 = state[1].index;
+    for (u32 frame = 0; frame < frames; frame += 8, data += 8)
+    {
+        u32 count = frames - frame < 8 ? frames - frame : 8;
+        u32 word0 = read_word(data);
+        u32 word1 = read_word(data + 4);
+        i16* out = dst + frame * 2;
+        for (u32 i = 0; i < count; ++i, word0 >>= 4, word1 >>= 4)
+        {
+            out[i * 2 + 0] = ima_decode_nibble(p0, index0, word0 & 0xF);
+            out[i * 2 + 1] = ima_decode_nibble(p1, index1, word1 & 0xF);
+        }
+    }
+}
+
+u32 ima_adpcm_block_frames(u32 block_bytes, i32 channels)
+{
+    if (channels < 1)
+        return 0;
+    const u32 header = 4 * static_cast<u32>(channels);
+    if (block_bytes < header)
+        return 0;
+    // Header sample, then 8 samples per channel for every 4 bytes per channel.
+    return 1 + (block_bytes - header) / header * 8;
+}
+
+u32 ima_adpcm_decode_block(const u8* block, u32 block_bytes, i32 channels, i16* dst, u32 max_frames)
+{
+    // Nothing may be written when the caller has no room, not even the header samples.
+    if (channels < 1 || channels > 2 || max_frames == 0)
+        return 0;
+    u32 frames = ima_adpcm_block_frames(block_bytes, channels);
+    if (frames == 0)
+        return 0;
+
+    ima_channel_t state[2];
+    for (i32 c = 0; c < channels; ++c)
+    {
+        const u8* header = block + 4 * c;
+        state[c].predictor = static_cast<i16>(header[0] | header[1] << 8);
+        state[c].index = header[2] > 88 ? 88 : header[2];
+        dst[c] = static_cast<i16>(state[c].predictor);
+    }
+
+    if (frames > max_frames)
+        frames = max_frames;
+
+    const u8* data = block + 4 * channels;
+    if (channels == 1)
+        ima_decode_mono(state, data, dst + 1, frames - 1);
+    else
+        ima_decode_stereo(state, data, dst + 2, frames - 1);
+    return frames;
+}
@@ -0,0 +1,101 @@
+#include <audio_offline.hpp>
+#include <dsp.hpp>
+#include <pcm.hpp>
+#include <wav.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static f64 offline_time()
+{
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool audio_render_offline(const config_t& config, const char* wav_path, f64 seconds, f64 clock_rate, audio_offline_result_t* result)
+{
+    if (!config.audio_callback && !config.audio_callback_f32)
+    {
+        LOG_ERROR("Offline audio rendering needs an audio callback");
+        return false;
+    }
+
+    const u32 sample_rate = config.audio_sample_rate;
+    const i32 channels = config.audio_channels;
+    const i32 frame_count = config.audio_frame_count;
+    const bool float_callback = config.audio_callback_f32 != nullptr;
+    const bool float_output = float_callback && config.audio_float_output;
+    const u64 total_frames = static_cast<u64>(seconds * sample_rate);
+    const f64 budget = static_cast<f64>(frame_count) / sample_rate;
+
+    wav_writer_t wav;
+    if (wav_path && !wav_open(&wav, wav_path, sample_rate, channels, float_output ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM))
+        return false;
+
+    // Float sized so S16 output converts in place, as on the device.
+    std::vector<f32> buffer(frame_count * channels);
+    pcm_dither_t dither;
+    audio_telemetry_t telemetry;
+    telemetry.reset(budget * 1000.0, static_cast<u32>(frame_count));
+
+    // Same floating point mode as the device audio thread, restored for the caller afterwards.
+    const u64 fp_state = dsp_flush_denormals();
+
+    bool ok = true;
+    u64 frames_done = 0;
+    const f64 start = offline_time();
+    while (frames_done < total_frames)
+    {
+        i32 frames = total_frames - frames_done < static_cast<u64>(frame_count) ? static_cast<i32>(total_frames - frames_done) : frame_count;
+        u32 count = static_cast<u32>(frames * channels);
+
+        f64 callback_start = offline_time();
+        if (float_callback)
+        {
+            config.audio_callback_f32(buffer.data(), frames, config.audio_userdata);
+            if (!float_output && config.audio_dither)
+                pcm_f32_to_s16_dither(buffer.data(), reinterpret_cast<i16*>(buffer.data()), count, &dither);
+            else if (!float_output)
+                pcm_f32_to_s16(buffer.data(), reinterpret_cast<i16*>(buffer.data()), count);
+        }
+        else
+        {
+            config.audio_callback(reinterpret_cast<i16*>(buffer.data()), frames, config.audio_userdata);
+        }
+        telemetry.record_callback(offline_time() - callback_start, budget);
+
+        if (wav_path && !wav_write(&wav, buffer.data(), static_cast<u32>(frames)))
+        {
+            ok = false;
+            break;
+        }
+        frames_done += frames;
+
+        // Release the next period when the simulated clock reaches it.
+        if (clock_rate > 0.0)
+        {
+            f64 due = start + static_cast<f64>(frames_done) / sample_rate / clock_rate;
+            f64 wait = due - offline_time();
+            if (wait > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<f64>(wait));
+        }
+    }
+    const f64 elapsed = offline_time() - start;
+    dsp_restore_denormals(fp_state);
+
+    if (wav_path)
+        wav_close(&wav);
+
+    if (result)
+    {
+        result->frames = frames_done;
+        result->audio_seconds = static_cast<f64>(frames_done) / sample_rate;
+        result->wall_seconds = elapsed;
+        result->realtime_multiple = elapsed > 0.0 ? result->audio_seconds / elapsed : 0.0;
+        telemetry.snapshot(&result->stats);
+    }
+
+    LOG_INFO("Rendered %.2f s of audio in %.3f s (%.1fx realtime)%s%s", static_cast<f64>(frames_done) / sample_rate,
+        elapsed, elapsed > 0.0 ? frames_done / (elapsed * sample_rate) : 0.0, wav_path ? " to " : "", wav_path ? wav_path : "");
+    return ok;
+}
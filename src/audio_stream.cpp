@@ -0,0 +1,180 @@
+#include <audio_stream.hpp>
+#include <adpcm.hpp>
+
+#include <chrono>
+#include <vector>
+
+// How long the decoder sleeps when the ring has no room for another block.
+#define AUDIO_STREAM_IDLE_MS 10
+
+static u64 stream_time_ns()
+{
+    return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static u32 stream_block_count(const wav_info_t& info)
+{
+    return (info.data_bytes + info.block_align - 1) / info.block_align;
+}
+
+// Decodes the next block into `dst`, wrapping or finishing at the end of the data.
+// Returns the frames produced, 0 once a non-looping stream is exhausted.
+static u32 stream_decode_block(audio_stream_t* stream, i16* dst)
+{
+    const wav_info_t& info = stream->info;
+    if (stream->frames_left == 0)
+    {
+        if (!stream->loop)
+            return 0;
+        stream->next_block = 0;
+        stream->frames_left = info.frames;
+    }
+
+    u32 offset = stream->next_block * info.block_align;
+    u32 bytes = info.data_bytes - offset < info.block_align ? info.data_bytes - offset : info.block_align;
+    u32 frames = 0;
+    if (info.format == WAV_FORMAT_IMA_ADPCM)
+    {
+        frames = ima_adpcm_decode_block(info.data + offset, bytes, info.channels, dst, info.frames_per_block);
+    }
+    else
+    {
+        // PCM "blocks" are single frames; copy a run of them at once.
+        u32 run = stream->frames_left < AUDIO_STREAM_RING_FRAMES / 8 ? stream->frames_left : AUDIO_STREAM_RING_FRAMES / 8;
+        memcpy(dst, info.data + offset, run * info.block_align);
+        frames = run;
+        stream->next_block += run - 1;
+    }
+    // A fact chunk may end the stream before the last block does.
+
+    if (frames > stream->frames_left)
+        frames = stream->frames_left;
+    stream->frames_left -= frames;
+    stream->next_block++;
+    if (stream->next_block >= stream_block_count(info) && stream->frames_left > 0)
+        stream->frames_left = 0;
+    return frames;
+}
+
+// Decodes until the ring is full; returns false when a non-looping stream has ended.
+static bool stream_fill(audio_stream_t* stream, std::vector<i16>& block)
+{
+    while (stream->ring.writable() >= block.size())
+    {
+        u64 start = stream_time_ns();
+        u32 frames = stream_decode_block(stream, block.data());
+        if (frames == 0)
+            return false;
+        stream->ring.write(block.data(), frames * stream->info.channels);
+        stream->decode_ns.store(stream->decode_ns.load(std::memory_order_relaxed) + stream_time_ns() - start, std::memory_order_relaxed);
+        stream->frames_decoded.store(stream->frames_decoded.load(std::memory_order_relaxed) + frames, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+static u32 stream_block_frames(const wav_info_t& info)
+{
+    return info.format == WAV_FORMAT_IMA_ADPCM ? info.frames_per_block : AUDIO_STREAM_RING_FRAMES / 8;
+}
+
+static void stream_thread_func(audio_stream_t* stream, std::vector<i16> block)
+{
+    while (stream->running.load(std::memory_order_acquire))
+    {
+        if (!stream_fill(stream, block))
+        {
+            stream->finished.store(true, std::memory_order_release);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_STREAM_IDLE_MS));
+    }
+}
+
+bool audio_stream_open_memory(audio_stream_t* stream, const u8* data, size_t size, bool loop)
+{
+    if (!wav_parse(data, size, &stream->info))
+        return false;
+
+    const wav_info_t& info = stream->info;
+    if (info.channels > 2 || info.frames == 0)
+    {
+        LOG_ERROR("Streams support mono or stereo audio only");
+        return false;
+    }
+    if (info.format == WAV_FORMAT_IMA_ADPCM &&
+        (info.frames_per_block != ima_adpcm_block_frames(info.block_align, info.channels) ||
+         info.frames_per_block > AUDIO_STREAM_RING_FRAMES / 2))
+    {
+        LOG_ERROR("Unsupported IMA-ADPCM block layout (%u frames in %u bytes)", info.frames_per_block, info.block_align);
+        return false;
+    }
+
+    stream->loop = loop;
+    stream->next_block = 0;
+    stream->frames_left = info.frames;
+    stream->ring.init(AUDIO_STREAM_RING_FRAMES * info.channels);
+    stream->finished.store(false);
+    stream->frames_decoded.store(0);
+    stream->decode_ns.store(0);
+    stream->underruns.store(0);
+
+    // Prime the ring here so playback can start immediately.
+    std::vector<i16> block(stream_block_frames(info) * info.channels);
+    if (!stream_fill(stream, block))
+        stream->finished.store(true);
+
+    stream->running.store(true, std::memory_order_release);
+    stream->thread = std::thread(stream_thread_func, stream, std::move(block));
+
+    LOG_INFO("Streaming %u frames, %d channels at %u Hz (%s)", info.frames, info.channels, info.sample_rate,
+        info.format == WAV_FORMAT_IMA_ADPCM ? "IMA-ADPCM" : "PCM");
+    return true;
+}
+
+bool audio_stream_open(audio_stream_t* stream, const char* path, bool loop)
+{
+    if (!map_file(path, &stream->file))
+        return false;
+
+    if (!audio_stream_open_memory(stream, stream->file.data, stream->file.size, loop))
+    {
+        unmap_file(&stream->file);
+        return false;
+    }
+    return true;
+}
+
+void audio_stream_close(audio_stream_t* stream)
+{
+    stream->running.store(false, std::memory_order_release);
+    if (stream->thread.joinable())
+        stream->thread.join();
+    unmap_file(&stream->file);
+}
+
+void audio_stream_get_stats(const audio_stream_t* stream, audio_stream_stats_t* stats)
+{
+    stats->frames_decoded = stream->frames_decoded.load(std::memory_order_relaxed);
+    stats->decode_ms = stream->decode_ns.load(std::memory_order_relaxed) * 1e-6;
+    stats->underruns = stream->underruns.load(std::memory_order_relaxed);
+}
+
+u32 audio_stream_peek(audio_stream_t* stream, i16* samples, u32 frames)
+{
+    const u32 channels = static_cast<u32>(stream->info.channels);
+    u32 got = stream->ring.peek(samples, frames * channels) / channels;
+    if (got < frames && !stream->finished.load(std::memory_order_acquire))
+        stream->underruns.store(stream->underruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return got;
+}
+
+void audio_stream_skip(audio_stream_t* stream, u32 frames)
+{
+    stream->ring.skip(frames * static_cast<u32>(stream->info.channels));
+}
+
+bool audio_stream_finished(const audio_stream_t* stream)
+{
+    return stream->finished.load(std::memory_order_acquire) && stream->ring.readable() < static_cast<u32>(stream->info.channels);
+}
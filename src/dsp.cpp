@@ -0,0 +1,232 @@
+#include <dsp.hpp>
+#include <simd.hpp>
+
+// dst[2i + 0] += src[i] * (l + i * dl), dst[2i + 1] += src[i] * (r + i * dr)
+void dsp_mix_mono_to_stereo(f32* dst, const f32* src, u32 frames, f32 l, f32 r, f32 dl, f32 dr)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const f32 g01[4] = { l, r, l + dl, r + dr };
+    const f32 g23[4] = { l + 2 * dl, r + 2 * dr, l + 3 * dl, r + 3 * dr };
+    const f32 step[4] = { 4 * dl, 4 * dr, 4 * dl, 4 * dr };
+    float32x4_t ga = vld1q_f32(g01), gb = vld1q_f32(g23), inc = vld1q_f32(step);
+    for (; i + 4 <= frames; i += 4)
+    {
+        float32x4x2_t s = vzipq_f32(vld1q_f32(src + i), vld1q_f32(src + i));
+        vst1q_f32(dst + 2 * i, vmlaq_f32(vld1q_f32(dst + 2 * i), s.val[0], ga));
+        vst1q_f32(dst + 2 * i + 4, vmlaq_f32(vld1q_f32(dst + 2 * i + 4), s.val[1], gb));
+        ga = vaddq_f32(ga, inc);
+        gb = vaddq_f32(gb, inc);
+    }
+#elif defined(SIMD_SSE2)
+    __m128 ga = _mm_setr_ps(l, r, l + dl, r + dr);
+    __m128 gb = _mm_setr_ps(l + 2 * dl, r + 2 * dr, l + 3 * dl, r + 3 * dr);
+    const __m128 inc = _mm_setr_ps(4 * dl, 4 * dr, 4 * dl, 4 * dr);
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 s = _mm_loadu_ps(src + i);
+        __m128 s01 = _mm_unpacklo_ps(s, s);
+        __m128 s23 = _mm_unpackhi_ps(s, s);
+        _mm_storeu_ps(dst + 2 * i, _mm_add_ps(_mm_loadu_ps(dst + 2 * i), _mm_mul_ps(s01, ga)));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(dst + 2 * i + 4), _mm_mul_ps(s23, gb)));
+        ga = _mm_add_ps(ga, inc);
+        gb = _mm_add_ps(gb, inc);
+    }
+#endif
+
+    for (; i < frames; ++i)
+    {
+        dst[2 * i + 0] += src[i] * (l + i * dl);
+        dst[2 * i + 1] += src[i] * (r + i * dr);
+    }
+}
+
+// dst[2i + 0] += src[2i + 0] * (l + i * dl), dst[2i + 1] += src[2i + 1] * (r + i * dr)
+void dsp_mix_stereo_to_stereo(f32* dst, const f32* src, u32 frames, f32 l, f32 r, f32 dl, f32 dr)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const f32 g01[4] = { l, r, l + dl, r + dr };
+    const f32 step[4] = { 2 * dl, 2 * dr, 2 * dl, 2 * dr };
+    float32x4_t g = vld1q_f32(g01), inc = vld1q_f32(step);
+    for (; i + 2 <= frames; i += 2)
+    {
+        vst1q_f32(dst + 2 * i, vmlaq_f32(vld1q_f32(dst + 2 * i), vld1q_f32(src + 2 * i), g));
+        g = vaddq_f32(g, inc);
+    }
+#elif defined(SIMD_SSE2)
+    __m128 g = _mm_setr_ps(l, r, l + dl, r + dr);
+    const __m128 inc = _mm_setr_ps(2 * dl, 2 * dr, 2 * dl, 2 * dr);
+    for (; i + 2 <= frames; i += 2)
+    {
+        __m128 s = _mm_loadu_ps(src + 2 * i);
+        _mm_storeu_ps(dst + 2 * i, _mm_add_ps(_mm_loadu_ps(dst + 2 * i), _mm_mul_ps(s, g)));
+        g = _mm_add_ps(g, inc);
+    }
+#endif
+
+    for (; i < frames; ++i)
+    {
+        dst[2 * i + 0] += src[2 * i + 0] * (l + i * dl);
+        dst[2 * i + 1] += src[2 * i + 1] * (r + i * dr);
+    }
+}
+
+void dsp_mix_to_mono(f32* dst, const f32* src, i32 channels, u32 frames, f32 g, f32 dg)
+{
+    if (channels == 1)
+    {
+        for (u32 i = 0; i < frames; ++i)
+            dst[i] += src[i] * (g + i * dg);
+    }
+    else
+    {
+        for (u32 i = 0; i < frames; ++i)
+            dst[i] += (src[2 * i] + src[2 * i + 1]) * 0.5f * (g + i * dg);
+    }
+}
+
+// dst[i] += src[i] * gain
+void dsp_mix_scaled(f32* dst, const f32* src, u32 count, f32 gain)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), g));
+#elif defined(SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+#endif
+
+    for (; i < count; ++i)
+        dst[i] += src[i] * gain;
+}
+
+void dsp_multiply(f32* dst, const f32* src, u32 count)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+#elif defined(SIMD_SSE2)
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+#endif
+
+    for (; i < count; ++i)
+        dst[i] *= src[i];
+}
+
+void dsp_scale(f32* dst, u32 count, f32 gain)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(dst + i), g));
+#elif defined(SIMD_SSE2)
+    const __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), g));
+#endif
+
+    for (; i < count; ++i)
+        dst[i] *= gain;
+}
+
+void dsp_deinterleave(const f32* src, f32* l, f32* r, u32 frames)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    for (; i + 4 <= frames; i += 4)
+    {
+        float32x4x2_t s = vld2q_f32(src + 2 * i);
+        vst1q_f32(l + i, s.val[0]);
+        vst1q_f32(r + i, s.val[1]);
+    }
+#elif defined(SIMD_SSE2)
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(src + 2 * i);
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+        _mm_storeu_ps(l + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(r + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#endif
+
+    for (; i < frames; ++i)
+    {
+        l[i] = src[2 * i + 0];
+        r[i] = src[2 * i + 1];
+    }
+}
+
+void dsp_interleave(const f32* l, const f32* r, f32* dst, u32 frames)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    for (; i + 4 <= frames; i += 4)
+    {
+        float32x4x2_t s = { { vld1q_f32(l + i), vld1q_f32(r + i) } };
+        vst2q_f32(dst + 2 * i, s);
+    }
+#elif defined(SIMD_SSE2)
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(l + i);
+        __m128 b = _mm_loadu_ps(r + i);
+        _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(a, b));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(a, b));
+    }
+#endif
+
+    for (; i < frames; ++i)
+    {
+        dst[2 * i + 0] = l[i];
+        dst[2 * i + 1] = r[i];
+    }
+}
+
+u64 dsp_flush_denormals()
+{
+#if defined(__aarch64__)
+    u64 fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ull << 24)));
+    return fpcr;
+#elif defined(__arm__) && defined(__ARM_FP)
+    // NEON always flushes; FZ makes the VFP instructions match.
+    u32 fpscr;
+    __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr | (1u << 24)));
+    return fpscr;
+#elif defined(SIMD_SSE2)
+    u32 csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);		// FTZ | DAZ
+    return csr;
+#else
+    return 0;
+#endif
+}
+
+void dsp_restore_denormals(u64 state)
+{
+#if defined(__aarch64__)
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(state));
+#elif defined(__arm__) && defined(__ARM_FP)
+    __asm__ __volatile__("vmsr fpscr, %0" : : "r"(static_cast<u32>(state)));
+#elif defined(SIMD_SSE2)
+    _mm_setcsr(static_cast<u32>(state));
+#else
+    (void)state;
+#endif
+}
@@ -0,0 +1,497 @@
+#include <device.hpp>
+#include <effects.hpp>
+#include <dsp.hpp>
+#include <simd.hpp>
+
+#include <chrono>
+#include <cmath>
+
+// Freeverb tunings at 44100 Hz, scaled to the effect rate.
+static const u32 REVERB_COMB_TUNING[EFFECT_REVERB_COMBS] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+static const u32 REVERB_ALLPASS_TUNING[EFFECT_REVERB_ALLPASSES] = { 556, 441, 341, 225 };
+static const u32 REVERB_STEREO_SPREAD = 23;
+static const f32 REVERB_INPUT_GAIN = 0.015f;
+static const f32 REVERB_ALLPASS_FEEDBACK = 0.5f;
+
+static u64 effect_time_ns()
+{
+    return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static u32 next_pow2(u32 v)
+{
+    u32 n = 1;
+    while (n < v)
+        n <<= 1;
+    return n;
+}
+
+static bool effect_begin(effect_t* effect, u8 type, u32 sample_rate, i32 channels)
+{
+    if (channels < 1 || channels > 2 || sample_rate == 0)
+    {
+        LOG_ERROR("Effects support 1 or 2 channels, got %d", channels);
+        return false;
+    }
+    if (effect->attached.load(std::memory_order_acquire))
+    {
+        LOG_ERROR("Effect is still attached to a mixer bus");
+        return false;
+    }
+
+    effect->type = type;
+    effect->sample_rate = sample_rate;
+    effect->channels = channels;
+    effect->blocks.store(0, std::memory_order_relaxed);
+    effect->frames.store(0, std::memory_order_relaxed);
+    effect->total_ns.store(0, std::memory_order_relaxed);
+    effect->max_ns.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+static void delay_line_init(effect_delay_line_t* line, u32 frames)
+{
+    line->buffer.assign(frames, 0.0f);
+    line->position = 0;
+}
+
+// RBJ audio EQ cookbook coefficients, normalised by a0.
+static void biquad_update(effect_t* effect)
+{
+    effect_biquad_t& bq = effect->biquad;
+    const f64 nyquist = effect->sample_rate * 0.5;
+    const f64 frequency = clamp(effect->params[EFFECT_BIQUAD_FREQUENCY], 10.0f, static_cast<f32>(nyquist * 0.99));
+    const f64 q = effect->params[EFFECT_BIQUAD_Q] > 0.01f ? effect->params[EFFECT_BIQUAD_Q] : 0.01;
+    const f64 w = 2.0 * 3.14159265358979323846 * frequency / effect->sample_rate;
+    const f64 cw = cos(w);
+    const f64 alpha = sin(w) / (2.0 * q);
+    const f64 a = pow(10.0, effect->params[EFFECT_BIQUAD_GAIN] / 40.0);
+    const f64 sa = 2.0 * sqrt(a) * alpha;
+
+    f64 b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+    switch (effect->mode)
+    {
+    case EFFECT_BIQUAD_LOWPASS:
+        b0 = (1.0 - cw) * 0.5; b1 = 1.0 - cw; b2 = b0;
+        a0 = 1.0 + alpha; a1 = -2.0 * cw; a2 = 1.0 - alpha;
+        break;
+    case EFFECT_BIQUAD_HIGHPASS:
+        b0 = (1.0 + cw) * 0.5; b1 = -(1.0 + cw); b2 = b0;
+        a0 = 1.0 + alpha; a1 = -2.0 * cw; a2 = 1.0 - alpha;
+        break;
+    case EFFECT_BIQUAD_BANDPASS:
+        b0 = alpha; b1 = 0.0; b2 = -alpha;
+        a0 = 1.0 + alpha; a1 = -2.0 * cw; a2 = 1.0 - alpha;
+        break;
+    case EFFECT_BIQUAD_NOTCH:
+        b0 = 1.0; b1 = -2.0 * cw; b2 = 1.0;
+        a0 = 1.0 + alpha; a1 = -2.0 * cw; a2 = 1.0 - alpha;
+        break;
+    case EFFECT_BIQUAD_PEAK:
+        b0 = 1.0 + alpha * a; b1 = -2.0 * cw; b2 = 1.0 - alpha * a;
+        a0 = 1.0 + alpha / a; a1 = -2.0 * cw; a2 = 1.0 - alpha / a;
+        break;
+    case EFFECT_BIQUAD_LOWSHELF:
+        b0 = a * ((a + 1.0) - (a - 1.0) * cw + sa);
+        b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cw);
+        b2 = a * ((a + 1.0) - (a - 1.0) * cw - sa);
+        a0 = (a + 1.0) + (a - 1.0) * cw + sa;
+        a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cw);
+        a2 = (a + 1.0) + (a - 1.0) * cw - sa;
+        break;
+    case EFFECT_BIQUAD_HIGHSHELF:
+        b0 = a * ((a + 1.0) + (a - 1.0) * cw + sa);
+        b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cw);
+        b2 = a * ((a + 1.0) + (a - 1.0) * cw - sa);
+        a0 = (a + 1.0) - (a - 1.0) * cw + sa;
+        a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cw);
+        a2 = (a + 1.0) - (a - 1.0) * cw - sa;
+        break;
+    default:
+        break;
+    }
+
+    bq.b0 = static_cast<f32>(b0 / a0);
+    bq.b1 = static_cast<f32>(b1 / a0);
+    bq.b2 = static_cast<f32>(b2 / a0);
+    bq.a1 = static_cast<f32>(a1 / a0);
+    bq.a2 = static_cast<f32>(a2 / a0);
+}
+
+static void delay_update(effect_t* effect)
+{
+    effect_delay_t& d = effect->delay;
+    f32 frames = effect->params[EFFECT_DELAY_TIME] * effect->sample_rate;
+    d.frames = frames < 1.0f ? 1 : (frames > d.max_frames ? d.max_frames : static_cast<u32>(frames));
+    effect->params[EFFECT_DELAY_FEEDBACK] = clamp(effect->params[EFFECT_DELAY_FEEDBACK], -0.98f, 0.98f);
+    effect->params[EFFECT_DELAY_MIX] = clamp(effect->params[EFFECT_DELAY_MIX], 0.0f, 1.0f);
+}
+
+static void reverb_update(effect_t* effect)
+{
+    effect_reverb_t& r = effect->reverb;
+    const f32 room = clamp(effect->params[EFFECT_REVERB_ROOM], 0.0f, 1.0f);
+    const f32 width = clamp(effect->params[EFFECT_REVERB_WIDTH], 0.0f, 1.0f);
+    const f32 mix = clamp(effect->params[EFFECT_REVERB_MIX], 0.0f, 1.0f);
+    r.feedback = room * 0.28f + 0.7f;
+    r.damp = clamp(effect->params[EFFECT_REVERB_DAMPING], 0.0f, 1.0f) * 0.4f;
+    r.wet1 = mix * (width * 0.5f + 0.5f);
+    r.wet2 = mix * (1.0f - width) * 0.5f;
+    r.dry = 1.0f - mix;
+}
+
+static void effect_update(effect_t* effect)
+{
+    switch (effect->type)
+    {
+    case EFFECT_BIQUAD: biquad_update(effect); break;
+    case EFFECT_DELAY: delay_update(effect); break;
+    case EFFECT_REVERB: reverb_update(effect); break;
+    default: break;
+    }
+}
+
+static void biquad_process(effect_biquad_t& bq, f32* samples, u32 frames)
+{
+    // The recursion is serial in time, so state and coefficients stay in registers.
+    const f32 b0 = bq.b0, b1 = bq.b1, b2 = bq.b2, a1 = bq.a1, a2 = bq.a2;
+    f32 z1 = bq.z1[0], z2 = bq.z2[0];
+    for (u32 i = 0; i < frames; ++i)
+    {
+        f32 x = samples[i];
+        f32 y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        samples[i] = y;
+    }
+    bq.z1[0] = z1;
+    bq.z2[0] = z2;
+}
+
+// Both channels in one loop: each recursion is latency bound, and the two are independent.
+static void biquad_process_stereo(effect_biquad_t& bq, f32* l, f32* r, u32 frames)
+{
+    const f32 b0 = bq.b0, b1 = bq.b1, b2 = bq.b2, a1 = bq.a1, a2 = bq.a2;
+    f32 lz1 = bq.z1[0], lz2 = bq.z2[0], rz1 = bq.z1[1], rz2 = bq.z2[1];
+    for (u32 i = 0; i < frames; ++i)
+    {
+        f32 lx = l[i], rx = r[i];
+        f32 ly = b0 * lx + lz1;
+        f32 ry = b0 * rx + rz1;
+        lz1 = b1 * lx - a1 * ly + lz2;
+        rz1 = b1 * rx - a1 * ry + rz2;
+        lz2 = b2 * lx - a2 * ly;
+        rz2 = b2 * rx - a2 * ry;
+        l[i] = ly;
+        r[i] = ry;
+    }
+    bq.z1[0] = lz1;
+    bq.z2[0] = lz2;
+    bq.z1[1] = rz1;
+    bq.z2[1] = rz2;
+}
+
+// line[w + i] = x[i] + tap[i] * feedback, x[i] = x[i] * dry + tap[i] * wet. The write
+// run never overlaps the tap run, so both are plain contiguous arrays.
+static void delay_run(f32* x, const f32* tap, f32* write, u32 count, f32 feedback, f32 dry, f32 wet)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const float32x4_t fb = vdupq_n_f32(feedback), vd = vdupq_n_f32(dry), vw = vdupq_n_f32(wet);
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t s = vld1q_f32(x + i);
+        float32x4_t t = vld1q_f32(tap + i);
+        vst1q_f32(write + i, vmlaq_f32(s, t, fb));
+        vst1q_f32(x + i, vmlaq_f32(vmulq_f32(s, vd), t, vw));
+    }
+#elif defined(SIMD_SSE2)
+    const __m128 fb = _mm_set1_ps(feedback), vd = _mm_set1_ps(dry), vw = _mm_set1_ps(wet);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 s = _mm_loadu_ps(x + i);
+        __m128 t = _mm_loadu_ps(tap + i);
+        _mm_storeu_ps(write + i, _mm_add_ps(s, _mm_mul_ps(t, fb)));
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_mul_ps(s, vd), _mm_mul_ps(t, vw)));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        f32 s = x[i], t = tap[i];
+        write[i] = s + t * feedback;
+        x[i] = s * dry + t * wet;
+    }
+}
+
+static void delay_process(effect_t* effect, f32* samples, u32 frames, u32 channel)
+{
+    effect_delay_t& d = effect->delay;
+    effect_delay_line_t& line = d.lines[channel];
+    const u32 mask = static_cast<u32>(line.buffer.size()) - 1;
+    const f32 feedback = effect->params[EFFECT_DELAY_FEEDBACK];
+    const f32 wet = effect->params[EFFECT_DELAY_MIX];
+    f32* buffer = line.buffer.data();
+
+    // Runs stop at the delay length and at either pointer wrapping, so they stay contiguous.
+    u32 done = 0;
+    while (done < frames)
+    {
+        u32 w = line.position;
+        u32 r = (w - d.frames) & mask;
+        u32 count = frames - done;
+        count = count < d.frames ? count : d.frames;
+        count = count < mask + 1 - w ? count : mask + 1 - w;
+        count = count < mask + 1 - r ? count : mask + 1 - r;
+        delay_run(samples + done, buffer + r, buffer + w, count, feedback, 1.0f - wet, wet);
+        line.position = (w + count) & mask;
+        done += count;
+    }
+}
+
+static void reverb_combs(effect_reverb_t& r, u32 channel, const f32* input, f32* output, u32 frames)
+{
+    // All eight combs advance together: their low-pass recursions are independent, so
+    // stepping them side by side keeps the pipeline busy where one comb would stall on
+    // its own feedback.
+    f32* buffers[EFFECT_REVERB_COMBS];
+    u32 positions[EFFECT_REVERB_COMBS];
+    u32 lengths[EFFECT_REVERB_COMBS];
+    f32 stores[EFFECT_REVERB_COMBS];
+    for (u32 k = 0; k < EFFECT_REVERB_COMBS; ++k)
+    {
+        buffers[k] = r.combs[channel][k].buffer.data();
+        positions[k] = r.combs[channel][k].position;
+        lengths[k] = static_cast<u32>(r.combs[channel][k].buffer.size());
+        stores[k] = r.comb_store[channel][k];
+    }
+
+    const f32 feedback = r.feedback, damp1 = r.damp, damp2 = 1.0f - r.damp;
+    for (u32 i = 0; i < frames; ++i)
+    {
+        f32 in = input[i], out = 0.0f;
+        for (u32 k = 0; k < EFFECT_REVERB_COMBS; ++k)
+        {
+            f32 tap = buffers[k][positions[k]];
+            stores[k] = tap * damp2 + stores[k] * damp1;
+            buffers[k][positions[k]] = in + stores[k] * feedback;
+            positions[k] = positions[k] + 1 == lengths[k] ? 0 : positions[k] + 1;
+            out += tap;
+        }
+        output[i] = out;
+    }
+
+    for (u32 k = 0; k < EFFECT_REVERB_COMBS; ++k)
+    {
+        r.combs[channel][k].position = positions[k];
+        r.comb_store[channel][k] = stores[k];
+    }
+}
+
+static void reverb_allpass(effect_delay_line_t& line, f32* samples, u32 frames)
+{
+    // Each frame reads and writes the same slot, so a run up to the wrap has no hazards.
+    f32* buffer = line.buffer.data();
+    const u32 length = static_cast<u32>(line.buffer.size());
+    u32 done = 0;
+    while (done < frames)
+    {
+        u32 p = line.position;
+        u32 count = frames - done < length - p ? frames - done : length - p;
+        f32* s = samples + done;
+        f32* b = buffer + p;
+        for (u32 i = 0; i < count; ++i)
+        {
+            f32 tap = b[i];
+            b[i] = s[i] + tap * REVERB_ALLPASS_FEEDBACK;
+            s[i] = tap - s[i];
+        }
+        line.position = p + count == length ? 0 : p + count;
+        done += count;
+    }
+}
+
+static void reverb_process(effect_t* effect, f32* const* channels, u32 frames)
+{
+    effect_reverb_t& r = effect->reverb;
+    f32* input = r.scratch.data();
+    f32* wet[2] = { input + EFFECT_MAX_FRAMES, input + 2 * EFFECT_MAX_FRAMES };
+
+    // Both channels feed the same mono input, as in Freeverb.
+    memcpy(input, channels[0], frames * sizeof(f32));
+    if (effect->channels == 2)
+        dsp_mix_scaled(input, channels[1], frames, 1.0f);
+    dsp_scale(input, frames, effect->channels == 2 ? REVERB_INPUT_GAIN : 2.0f * REVERB_INPUT_GAIN);
+
+    for (i32 c = 0; c < effect->channels; ++c)
+    {
+        reverb_combs(r, c, input, wet[c], frames);
+        for (u32 k = 0; k < EFFECT_REVERB_ALLPASSES; ++k)
+            reverb_allpass(r.allpasses[c][k], wet[c], frames);
+    }
+
+    if (effect->channels == 1)
+    {
+        dsp_scale(channels[0], frames, r.dry);
+        dsp_mix_scaled(channels[0], wet[0], frames, r.wet1 + r.wet2);
+        return;
+    }
+    for (u32 c = 0; c < 2; ++c)
+    {
+        dsp_scale(channels[c], frames, r.dry);
+        dsp_mix_scaled(channels[c], wet[c], frames, r.wet1);
+        dsp_mix_scaled(channels[c], wet[1 - c], frames, r.wet2);
+    }
+}
+
+bool effect_init_biquad(effect_t* effect, u32 sample_rate, i32 channels, u8 mode, f32 frequency, f32 q, f32 gain_db)
+{
+    if (!effect_begin(effect, EFFECT_BIQUAD, sample_rate, channels))
+        return false;
+
+    effect->mode = mode;
+    effect->params[EFFECT_BIQUAD_FREQUENCY] = frequency;
+    effect->params[EFFECT_BIQUAD_Q] = q;
+    effect->params[EFFECT_BIQUAD_GAIN] = gain_db;
+    effect_update(effect);
+    effect_reset(effect);
+    return true;
+}
+
+bool effect_init_delay(effect_t* effect, u32 sample_rate, i32 channels, f32 max_seconds, f32 seconds, f32 feedback, f32 mix)
+{
+    if (!effect_begin(effect, EFFECT_DELAY, sample_rate, channels))
+        return false;
+
+    effect_delay_t& d = effect->delay;
+    d.max_frames = max_seconds * sample_rate > 1.0f ? static_cast<u32>(max_seconds * sample_rate) : 1;
+    // Room for the longest delay plus a whole block, so a block's write run never reaches its tap.
+    for (i32 c = 0; c < channels; ++c)
+        delay_line_init(&d.lines[c], next_pow2(d.max_frames + EFFECT_MAX_FRAMES));
+
+    effect->params[EFFECT_DELAY_TIME] = seconds;
+    effect->params[EFFECT_DELAY_FEEDBACK] = feedback;
+    effect->params[EFFECT_DELAY_MIX] = mix;
+    effect_update(effect);
+    return true;
+}
+
+bool effect_init_reverb(effect_t* effect, u32 sample_rate, i32 channels, f32 room, f32 damping, f32 width, f32 mix)
+{
+    if (!effect_begin(effect, EFFECT_REVERB, sample_rate, channels))
+        return false;
+
+    effect_reverb_t& r = effect->reverb;
+    const f64 scale = sample_rate / 44100.0;
+    for (i32 c = 0; c < channels; ++c)
+    {
+        u32 spread = c == 0 ? 0 : REVERB_STEREO_SPREAD;
+        for (u32 k = 0; k < EFFECT_REVERB_COMBS; ++k)
+            delay_line_init(&r.combs[c][k], static_cast<u32>((REVERB_COMB_TUNING[k] + spread) * scale));
+        for (u32 k = 0; k < EFFECT_REVERB_ALLPASSES; ++k)
+            delay_line_init(&r.allpasses[c][k], static_cast<u32>((REVERB_ALLPASS_TUNING[k] + spread) * scale));
+    }
+    r.scratch.assign(EFFECT_MAX_FRAMES * 3, 0.0f);
+
+    effect->params[EFFECT_REVERB_ROOM] = room;
+    effect->params[EFFECT_REVERB_DAMPING] = damping;
+    effect->params[EFFECT_REVERB_WIDTH] = width;
+    effect->params[EFFECT_REVERB_MIX] = mix;
+    effect_update(effect);
+    effect_reset(effect);
+    return true;
+}
+
+void effect_shutdown(effect_t* effect)
+{
+    ASSERT(!effect->attached.load(std::memory_order_acquire), "Effect shut down while attached to a mixer bus");
+    for (u32 c = 0; c < 2; ++c)
+    {
+        effect->delay.lines[c].buffer.clear();
+        for (auto& line : effect->reverb.combs[c])
+            line.buffer.clear();
+        for (auto& line : effect->reverb.allpasses[c])
+            line.buffer.clear();
+    }
+    effect->reverb.scratch.clear();
+    effect->channels = 0;
+}
+
+void effect_reset(effect_t* effect)
+{
+    for (u32 c = 0; c < 2; ++c)
+    {
+        effect->biquad.z1[c] = effect->biquad.z2[c] = 0.0f;
+        delay_line_init(&effect->delay.lines[c], static_cast<u32>(effect->delay.lines[c].buffer.size()));
+        for (auto& line : effect->reverb.combs[c])
+            delay_line_init(&line, static_cast<u32>(line.buffer.size()));
+        for (auto& line : effect->reverb.allpasses[c])
+            delay_line_init(&line, static_cast<u32>(line.buffer.size()));
+        for (auto& store : effect->reverb.comb_store[c])
+            store = 0.0f;
+    }
+}
+
+void effect_set_param(effect_t* effect, u32 param, f32 value)
+{
+    if (param >= EFFECT_PARAM_COUNT)
+        return;
+    effect->params[param] = value;
+    effect_update(effect);
+}
+
+void effect_process(effect_t* effect, f32* const* channels, u32 frames)
+{
+    const u64 start = effect_time_ns();
+
+    u32 done = 0;
+    while (done < frames)
+    {
+        u32 count = frames - done < EFFECT_MAX_FRAMES ? frames - done : EFFECT_MAX_FRAMES;
+        f32* block[2] = { channels[0] + done, effect->channels == 2 ? channels[1] + done : nullptr };
+        switch (effect->type)
+        {
+        case EFFECT_BIQUAD:
+            if (effect->channels == 2)
+                biquad_process_stereo(effect->biquad, block[0], block[1], count);
+            else
+                biquad_process(effect->biquad, block[0], count);
+            break;
+        case EFFECT_DELAY:
+            for (i32 c = 0; c < effect->channels; ++c)
+                delay_process(effect, block[c], count, c);
+            break;
+        case EFFECT_REVERB:
+            reverb_process(effect, block, count);
+            break;
+        default:
+            break;
+        }
+        done += count;
+    }
+
+    // Single writer, so plain load/store like audio_telemetry_t.
+    const u64 ns = effect_time_ns() - start;
+    effect->blocks.store(effect->blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    effect->frames.store(effect->frames.load(std::memory_order_relaxed) + frames, std::memory_order_relaxed);
+    effect->total_ns.store(effect->total_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if (ns > effect->max_ns.load(std::memory_order_relaxed))
+        effect->max_ns.store(static_cast<u32>(ns), std::memory_order_relaxed);
+}
+
+bool effect_attached(const effect_t* effect)
+{
+    return effect->attached.load(std::memory_order_acquire);
+}
+
+void effect_get_stats(const effect_t* effect, effect_stats_t* stats)
+{
+    u64 blocks = effect->blocks.load(std::memory_order_relaxed);
+    u64 frames = effect->frames.load(std::memory_order_relaxed);
+    f64 total_us = effect->total_ns.load(std::memory_order_relaxed) * 1e-3;
+    stats->blocks = blocks;
+    stats->block_avg_us = blocks ? total_us / blocks : 0.0;
+    stats->block_max_us = effect->max_ns.load(std::memory_order_relaxed) * 1e-3;
+    stats->load = frames ? total_us * 1e-6 / (static_cast<f64>(frames) / effect->sample_rate) : 0.0;
+}
@@ -0,0 +1,165 @@
+#include <device.hpp>
+#include <frame_stats.hpp>
+#include <algorithm>
+
+// Desktop GL 3.3 has 64-bit query results in core, GLES only through the extension.
+#define glGetQueryObjectui64vX (glGetQueryObjectui64v ? glGetQueryObjectui64v : glGetQueryObjectui64vEXT)
+
+static frame_timing_t frame_ring[FRAME_STATS_CAPACITY];
+static u64 frame_count = 0;			// Frames completed
+static u64 frame_begin_ns = 0;
+static u64 frame_present_ns = 0;
+static bool frame_open = false;
+
+static bool frame_gpu_timing = false;
+static GLuint frame_queries[FRAME_GPU_QUERIES];
+static u64 frame_query_index[FRAME_GPU_QUERIES];	// Frame each query measured
+static bool frame_query_pending[FRAME_GPU_QUERIES];
+
+void frame_stats_init()
+{
+    memset(frame_ring, 0, sizeof(frame_ring));
+    frame_count = 0;
+    frame_open = false;
+
+    frame_gpu_timing = (GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query || GLAD_GL_EXT_disjoint_timer_query) &&
+        glGenQueries && glBeginQuery && glEndQuery && glGetQueryObjectui64vX;
+    if (!frame_gpu_timing)
+    {
+        LOG_WARN("GPU timer queries unavailable, frame stats will not include GPU time");
+        return;
+    }
+
+    glGenQueries(FRAME_GPU_QUERIES, frame_queries);
+    for (u32 i = 0; i < FRAME_GPU_QUERIES; ++i)
+        frame_query_pending[i] = false;
+}
+
+void frame_stats_shutdown()
+{
+    if (frame_gpu_timing)
+        glDeleteQueries(FRAME_GPU_QUERIES, frame_queries);
+    frame_gpu_timing = false;
+}
+
+// Reads finished queries without waiting on the GPU.
+static void collect_gpu_times()
+{
+    GLint disjoint = 0;
+    if (GLAD_GL_EXT_disjoint_timer_query)
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    for (u32 i = 0; i < FRAME_GPU_QUERIES; ++i)
+    {
+        if (!frame_query_pending[i])
+            continue;
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64vX(frame_queries[i], GL_QUERY_RESULT, &ns);
+        frame_query_pending[i] = false;
+
+        // A disjoint counter (frequency change, context loss) makes the result meaningless.
+        frame_timing_t& timing = frame_ring[frame_query_index[i] & (FRAME_STATS_CAPACITY - 1)];
+        if (!disjoint && timing.index == frame_query_index[i])
+            timing.gpu_ns = ns;
+    }
+}
+
+void frame_stats_begin(u64 now_ns)
+{
+    if (frame_open)
+    {
+        frame_timing_t& timing = frame_ring[frame_count & (FRAME_STATS_CAPACITY - 1)];
+        timing.index = frame_count;
+        timing.frame_ns = now_ns - frame_begin_ns;
+        timing.cpu_ns = frame_present_ns - frame_begin_ns;
+        timing.gpu_ns = 0;
+        frame_count++;
+    }
+    frame_begin_ns = now_ns;
+    frame_open = true;
+
+    if (!frame_gpu_timing)
+        return;
+
+    collect_gpu_times();
+    u32 slot = frame_count % FRAME_GPU_QUERIES;
+    if (frame_query_pending[slot])
+        return;		// The GPU is more than FRAME_GPU_QUERIES frames behind; skip this one
+
+    glBeginQuery(GL_TIME_ELAPSED, frame_queries[slot]);
+    frame_query_index[slot] = frame_count;
+    frame_query_pending[slot] = true;
+}
+
+void frame_stats_present(u64 now_ns)
+{
+    frame_present_ns = now_ns;
+    u32 slot = frame_count % FRAME_GPU_QUERIES;
+    if (frame_gpu_timing && frame_query_pending[slot] && frame_query_index[slot] == frame_count)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+void frame_stats_end(u64 now_ns)
+{
+    // The frame is filed at the next begin, which knows its full length.
+    frame_ring[frame_count & (FRAME_STATS_CAPACITY - 1)].present_ns = now_ns - frame_present_ns;
+}
+
+static void percentiles(u64* values, u32 count, frame_percentiles_t* out)
+{
+    memset(out, 0, sizeof(*out));
+    if (count == 0)
+        return;
+
+    u64 total = 0;
+    for (u32 i = 0; i < count; ++i)
+        total += values[i];
+    std::sort(values, values + count);
+
+    // Nearest rank
+    out->avg_ms = total * 1e-6 / count;
+    out->p50_ms = values[(count - 1) * 50 / 100] * 1e-6;
+    out->p95_ms = values[(count - 1) * 95 / 100] * 1e-6;
+    out->p99_ms = values[(count - 1) * 99 / 100] * 1e-6;
+    out->max_ms = values[count - 1] * 1e-6;
+}
+
+void get_frame_stats(frame_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    u32 count = frame_count < FRAME_STATS_CAPACITY ? static_cast<u32>(frame_count) : FRAME_STATS_CAPACITY;
+    stats->frames = count;
+    stats->gpu_timing = frame_gpu_timing;
+
+    u64 values[FRAME_STATS_CAPACITY];
+    u32 gpu_count = 0;
+    for (u32 i = 0; i < count; ++i)
+    {
+        const frame_timing_t& timing = frame_ring[i];
+        values[i] = timing.frame_ns;
+        if (timing.frame_ns > stats->worst.frame_ns)
+            stats->worst = timing;
+    }
+    percentiles(values, count, &stats->frame);
+
+    for (u32 i = 0; i < count; ++i)
+        values[i] = frame_ring[i].cpu_ns;
+    percentiles(values, count, &stats->cpu);
+
+    for (u32 i = 0; i < count; ++i)
+        values[i] = frame_ring[i].present_ns;
+    percentiles(values, count, &stats->present);
+
+    for (u32 i = 0; i < count; ++i)
+    {
+        if (frame_ring[i].gpu_ns > 0)
+            values[gpu_count++] = frame_ring[i].gpu_ns;
+    }
+    percentiles(values, gpu_count, &stats->gpu);
+}
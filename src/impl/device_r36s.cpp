@@ -1,8 +1,27 @@
 #include <device.hpp>
+#include <dsp.hpp>
+#include <loader.hpp>
+#include <mixer.hpp>
+#include <pcm.hpp>
+#include <resampler.hpp>
+#include <ring.hpp>
+#include <audio_stats.hpp>
+#include <audio_clock.hpp>
+#include <profiler.hpp>
 
 #include <fcntl.h>
 #include <unistd.h>
-#include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <time.h>
 #include <linux/input.h>
 #include <alsa/asoundlib.h>
@@ -21,7 +40,179 @@
 // Timing
 static struct timespec device_start_ts;
 
+static f64 timespec_to_time(const struct timespec& ts)
+{
+    return (ts.tv_sec - device_start_ts.tv_sec) +
+        (ts.tv_nsec - device_start_ts.tv_nsec) * 1e-9;
+}
+
+// Event loop
+// Each waiting thread owns one epoll set and sleeps in event_loop_run() until one of
+// its descriptors is ready, so nothing wakes up on a poll interval. Callbacks run on
+// the thread that called event_loop_run().
+#define EVENT_LOOP_SOURCES 16
+
+typedef void (*event_callback_t)(u32 events, void* userdata);
+
+struct event_source_t
+{
+    i32 fd;
+    event_callback_t callback;
+    void* userdata;
+    bool timer;		// Owned timerfd, read before the callback and closed with the loop
+};
+
+struct event_loop_t
+{
+    i32 epoll_fd{ -1 };
+    event_source_t sources[EVENT_LOOP_SOURCES];
+    u32 source_count{ 0 };
+};
+
+static bool event_loop_init(event_loop_t* loop)
+{
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->source_count = 0;
+    return loop->epoll_fd >= 0;
+}
+
+static void event_loop_shutdown(event_loop_t* loop)
+{
+    for (u32 i = 0; i < loop->source_count; ++i)
+    {
+        if (loop->sources[i].timer && loop->sources[i].fd >= 0)
+            close(loop->sources[i].fd);
+    }
+    if (loop->epoll_fd >= 0)
+        close(loop->epoll_fd);
+    loop->epoll_fd = -1;
+    loop->source_count = 0;
+}
+
+// `events` are EPOLLIN / EPOLLOUT, which share their values with poll()'s.
+static bool event_loop_add(event_loop_t* loop, i32 fd, u32 events, event_callback_t callback, void* userdata)
+{
+    event_source_t* source = nullptr;
+    for (u32 i = 0; i < loop->source_count && !source; ++i)
+    {
+        if (loop->sources[i].fd < 0)
+            source = &loop->sources[i];
+    }
+    if (!source && loop->source_count < EVENT_LOOP_SOURCES)
+        source = &loop->sources[loop->source_count++];
+    if (!source)
+        return false;
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = source;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        return false;
+
+    source->fd = fd;
+    source->callback = callback;
+    source->userdata = userdata;
+    source->timer = false;
+    return true;
+}
+
+static void event_loop_remove(event_loop_t* loop, i32 fd)
+{
+    for (u32 i = 0; i < loop->source_count; ++i)
+    {
+        event_source_t& source = loop->sources[i];
+        if (source.fd != fd)
+            continue;
+
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        if (source.timer)
+            close(fd);
+        source.fd = -1;
+        source.callback = nullptr;
+    }
+}
+
+// Returns the timer's descriptor for event_loop_arm_timer(), or -1.
+static i32 event_loop_add_timer(event_loop_t* loop, event_callback_t callback, void* userdata)
+{
+    i32 fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0)
+        return -1;
+    if (!event_loop_add(loop, fd, EPOLLIN, callback, userdata))
+    {
+        close(fd);
+        return -1;
+    }
+
+    for (u32 i = 0; i < loop->source_count; ++i)
+    {
+        if (loop->sources[i].fd == fd)
+            loop->sources[i].timer = true;
+    }
+    return fd;
+}
+
+// Fires once after `delay` seconds, then every `interval` seconds if non-zero.
+// A zero delay disarms the timer.
+static void event_loop_arm_timer(i32 fd, f64 delay, f64 interval)
+{
+    struct itimerspec spec;
+    spec.it_value.tv_sec = static_cast<time_t>(delay);
+    spec.it_value.tv_nsec = static_cast<long>((delay - static_cast<f64>(spec.it_value.tv_sec)) * 1e9);
+    spec.it_interval.tv_sec = static_cast<time_t>(interval);
+    spec.it_interval.tv_nsec = static_cast<long>((interval - static_cast<f64>(spec.it_interval.tv_sec)) * 1e9);
+    timerfd_settime(fd, 0, &spec, nullptr);
+}
+
+// Waits up to `timeout_ms` (-1 forever, 0 to only dispatch what is ready) and runs the
+// callbacks of the ready sources. Returns how many ran.
+static i32 event_loop_run(event_loop_t* loop, i32 timeout_ms)
+{
+    struct epoll_event events[EVENT_LOOP_SOURCES];
+    i32 count = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_SOURCES, timeout_ms);
+    if (count < 0)
+        return 0;
+
+    i32 dispatched = 0;
+    for (i32 i = 0; i < count; ++i)
+    {
+        auto* source = static_cast<event_source_t*>(events[i].data.ptr);
+        if (!source->callback)
+            continue;		// Removed by an earlier callback of this batch
+
+        if (source->timer)
+        {
+            u64 expirations;
+            if (read(source->fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                continue;
+        }
+        source->callback(events[i].events, source->userdata);
+        dispatched++;
+    }
+    return dispatched;
+}
+
+// Writes to an eventfd so the loop waiting on it returns.
+static void event_loop_wake(i32 fd)
+{
+    u64 wake = 1;
+    if (write(fd, &wake, sizeof(wake)) != sizeof(wake))
+        LOG_WARN("Failed to wake event loop: %s", strerror(errno));
+}
+
+static void event_loop_drain_wake(u32, void* userdata)
+{
+    u64 value;
+    if (read(*static_cast<i32*>(userdata), &value, sizeof(value)) != sizeof(value))
+        return;
+}
+
+// The game thread's loop: page flip events, and the input device unless it has a thread.
+static event_loop_t device_loop;
+
 // Display
+#define DISPLAY_FLIP_TIMEOUT 0.1		// Seconds before a missing flip event is reported
+
 static i32 display_drm_fd;
 static drmModeRes* display_drm_res = nullptr;
 static drmModeConnector* display_drm_conn = nullptr;
@@ -32,17 +223,96 @@ static gbm_surface* display_gbm_surface = nullptr;
 static EGLDisplay display_egl_display;
 static EGLContext display_egl_context;
 static EGLSurface display_egl_surface;
+static EGLConfig display_egl_config;
+static EGLContext display_egl_upload_context = EGL_NO_CONTEXT;
+static EGLSurface display_egl_upload_surface = EGL_NO_SURFACE;
 static struct gbm_bo* display_gbm_previous_bo = nullptr;
 static u32 display_gbm_previous_fb = 0;
 static bool display_should_close = false;
+static f64 display_present_time = 0.0;
+static i32 display_flip_timer = -1;
+static bool display_flip_late = false;
 
-static void page_flip_handler(i32, u32, u32, u32, u32, void* data)
+static void page_flip_handler(i32, u32, u32 tv_sec, u32 tv_usec, u32, void* data)
 {
     auto* flip_done = reinterpret_cast<i32*>(data);
     *flip_done = 1;
+
+    // DRM stamps flips with CLOCK_MONOTONIC, the clock get_time() runs on.
+    struct timespec ts;
+    ts.tv_sec = tv_sec;
+    ts.tv_nsec = static_cast<long>(tv_usec) * 1000;
+    display_present_time = timespec_to_time(ts);
+}
+
+static drmEventContext display_drm_events = { DRM_EVENT_CONTEXT_VERSION, nullptr, nullptr, page_flip_handler };
+
+static void display_drm_callback(u32, void*)
+{
+    drmHandleEvent(display_drm_fd, &display_drm_events);
+}
+
+static void display_flip_timer_callback(u32, void*)
+{
+    if (!display_flip_late)
+        LOG_WARN("Page flip still pending after %.0f ms; is the display off?", DISPLAY_FLIP_TIMEOUT * 1000.0);
+    display_flip_late = true;
 }
 
-static bool display_init(bool vsync)
+static bool display_upload_context_init()
+{
+    LOG_INFO("Creating shared upload context...");
+
+    // The upload context never renders, so it only needs a surface when surfaceless
+    // contexts are unsupported. The display config only promises window surfaces, so a
+    // pbuffer gets a config of its own and the context is created to match it.
+    const char* extensions = eglQueryString(display_egl_display, EGL_EXTENSIONS);
+    bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+    EGLConfig config = display_egl_config;
+    if (!surfaceless)
+    {
+        static const EGLint pbuffer_cfg[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+            EGL_NONE
+        };
+        EGLint num = 0;
+        if (!eglChooseConfig(display_egl_display, pbuffer_cfg, &config, 1, &num) || num < 1)
+        {
+            LOG_WARN("Shared upload context requires EGL_KHR_surfaceless_context or pbuffer support");
+            return false;
+        }
+    }
+
+    static const EGLint ctx[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    display_egl_upload_context = eglCreateContext(display_egl_display, config, display_egl_context, ctx);
+    if (display_egl_upload_context == EGL_NO_CONTEXT)
+    {
+        LOG_WARN("eglCreateContext failed for shared upload context");
+        return false;
+    }
+
+    if (!surfaceless)
+    {
+        static const EGLint pbuffer[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        display_egl_upload_surface = eglCreatePbufferSurface(display_egl_display, config, pbuffer);
+        if (display_egl_upload_surface == EGL_NO_SURFACE)
+        {
+            LOG_WARN("eglCreatePbufferSurface failed for shared upload context");
+            eglDestroyContext(display_egl_display, display_egl_upload_context);
+            display_egl_upload_context = EGL_NO_CONTEXT;
+            return false;
+        }
+    }
+
+    LOG_INFO("Shared upload context created");
+    return true;
+}
+
+static bool display_init(bool vsync, bool upload_context)
 {
     LOG_INFO("Opening DRM device...");
     display_drm_fd = open("/dev/dri/card0", O_RDWR | O_CLOEXEC);
@@ -100,16 +370,15 @@ static bool display_init(bool vsync)
         EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
         EGL_NONE
     };
-    EGLConfig config;
     EGLint num;
-    eglChooseConfig(display_egl_display, cfg, &config, 1, &num);
+    eglChooseConfig(display_egl_display, cfg, &display_egl_config, 1, &num);
     LOG_INFO("EGL config chosen (%d configs available)", num);
 
     static const EGLint ctx[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
-    display_egl_context = eglCreateContext(display_egl_display, config, EGL_NO_CONTEXT, ctx);
+    display_egl_context = eglCreateContext(display_egl_display, display_egl_config, EGL_NO_CONTEXT, ctx);
     ASSERT(display_egl_context != EGL_NO_CONTEXT, "eglCreateContext failed");
 
-    display_egl_surface = eglCreateWindowSurface(display_egl_display, config, reinterpret_cast<EGLNativeWindowType>(display_gbm_surface), nullptr);
+    display_egl_surface = eglCreateWindowSurface(display_egl_display, display_egl_config, reinterpret_cast<EGLNativeWindowType>(display_gbm_surface), nullptr);
     ASSERT(display_egl_surface != EGL_NO_SURFACE, "eglCreateWindowSurface failed");
 
     eglMakeCurrent(display_egl_display, display_egl_surface, display_egl_surface, display_egl_context);
@@ -117,6 +386,22 @@ static bool display_init(bool vsync)
 
     eglSwapInterval(display_egl_display, vsync ? 1 : 0);
 
+    // display_present() waits on this loop for page flips, so it cannot run without it.
+    if (!event_loop_init(&device_loop) ||
+        !event_loop_add(&device_loop, display_drm_fd, EPOLLIN, display_drm_callback, nullptr))
+    {
+        LOG_ERROR("Failed to create the device event loop: %s", strerror(errno));
+        event_loop_shutdown(&device_loop);
+        return false;
+    }
+    display_flip_timer = event_loop_add_timer(&device_loop, display_flip_timer_callback, nullptr);
+    if (display_flip_timer < 0)
+    {
+        LOG_ERROR("Failed to create the page flip timer: %s", strerror(errno));
+        event_loop_shutdown(&device_loop);
+        return false;
+    }
+
     display_gbm_previous_bo = nullptr;
     display_gbm_previous_fb = 0;
 
@@ -126,6 +411,9 @@ static bool display_init(bool vsync)
     else
         LOG_INFO("GLAD initialized");
 
+    if (upload_context && !display_upload_context_init())
+        LOG_WARN("Continuing without background GPU uploads.");
+
     display_should_close = false;
     return true;
 }
@@ -138,6 +426,15 @@ static void display_shutdown()
         drmModeRmFB(display_drm_fd, display_gbm_previous_fb);
     }
 
+    if (display_egl_upload_context != EGL_NO_CONTEXT)
+    {
+        if (display_egl_upload_surface != EGL_NO_SURFACE)
+            eglDestroySurface(display_egl_display, display_egl_upload_surface);
+        eglDestroyContext(display_egl_display, display_egl_upload_context);
+        display_egl_upload_surface = EGL_NO_SURFACE;
+        display_egl_upload_context = EGL_NO_CONTEXT;
+    }
+
     eglDestroySurface(display_egl_display, display_egl_surface);
     eglDestroyContext(display_egl_display, display_egl_context);
     eglTerminate(display_egl_display);
@@ -146,11 +443,14 @@ static void display_shutdown()
     drmModeFreeEncoder(display_drm_enc);
     drmModeFreeConnector(display_drm_conn);
     drmModeFreeResources(display_drm_res);
+    event_loop_shutdown(&device_loop);
+    display_flip_timer = -1;
     close(display_drm_fd);
 }
 
 static void display_present()
 {
+    PROFILE_SCOPE("display_present");
     eglSwapBuffers(display_egl_display, display_egl_surface);
     struct gbm_bo* bo = gbm_surface_lock_front_buffer(display_gbm_surface);
     if (!bo) return;
@@ -169,6 +469,7 @@ static void display_present()
 
         display_gbm_previous_bo = bo;
         display_gbm_previous_fb = fb;
+        display_present_time = get_time();
         return;
     }
 
@@ -176,16 +477,15 @@ static void display_present()
     {
         i32 flip_done = 0;
         drmModePageFlip(display_drm_fd, display_drm_enc->crtc_id, fb, DRM_MODE_PAGE_FLIP_EVENT, &flip_done);
-        drmEventContext evctx = { DRM_EVENT_CONTEXT_VERSION, nullptr, nullptr, page_flip_handler };
 
+        // Sleep until the vblank completes the flip; input arriving meanwhile is read as it comes.
+        if (display_flip_timer >= 0)
+            event_loop_arm_timer(display_flip_timer, DISPLAY_FLIP_TIMEOUT, 0.0);
         while (!flip_done)
-        {
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(display_drm_fd, &fds);
-            select(display_drm_fd + 1, &fds, nullptr, nullptr, nullptr);
-            drmHandleEvent(display_drm_fd, &evctx);
-        }
+            event_loop_run(&device_loop, -1);
+        if (display_flip_timer >= 0)
+            event_loop_arm_timer(display_flip_timer, 0.0, 0.0);
+        display_flip_late = false;
 
         if (display_gbm_previous_bo)
         {
@@ -202,74 +502,481 @@ static void display_present()
 }
 
 // Audio
+#define AUDIO_COMMAND_CAPACITY 256
+#define AUDIO_STACK_PREFAULT (64 * 1024)
+#define AUDIO_POLL_FDS 8
 static snd_pcm_t* pcm = nullptr;
 static u32 audio_sample_rate;
 static i32 audio_channels;
 static i32 audio_frame_count;
+static i32 audio_buffer_frames;
+static i32 audio_period_count;
+static std::atomic<f64> audio_play_end_time(0.0);
 static std::thread audio_thread;
 static config_t::audio_callback_t audio_callback;
+static config_t::audio_callback_f32_t audio_callback_f32;
+static bool audio_float_output = false;
+static bool audio_dither_enabled = true;
+static pcm_dither_t audio_dither;
+static std::vector<f32> audio_float_buffer;
+static bool audio_resampling = false;
+static resampler_t audio_resampler;
+static std::vector<f32> audio_resample_input;
+static std::vector<i16> audio_resample_s16;
 static void* audio_userdata = nullptr;
+static config_t::audio_command_callback_t audio_command_callback;
+static spsc_ring_t<audio_command_t, AUDIO_COMMAND_CAPACITY> audio_commands;
 static std::atomic<bool> audio_running(false);
+static bool audio_mmap = false;
+static u8 audio_thread_policy = AUDIO_SCHED_DEFAULT;
+static i32 audio_thread_priority = 0;
+static i32 audio_thread_cpu = -1;
+static bool audio_lock_memory = false;
+static audio_telemetry_t audio_telemetry;
+static audio_clock_t audio_clock;
+static mixer_t audio_mixer;
+static bool audio_mixer_enabled = false;
+static event_loop_t audio_loop;
+static i32 audio_wake_fd = -1;
+static struct pollfd audio_poll_fds[AUDIO_POLL_FDS];
+static i32 audio_poll_count = 0;
+
+static void audio_drain_commands()
+{
+    audio_command_t command;
+    while (audio_commands.pop(&command))
+    {
+        if (audio_command_callback)
+            audio_command_callback(command, audio_userdata);
+    }
+}
+
+static void audio_convert(const f32* src, void* samples, i32 frames)
+{
+    u32 count = static_cast<u32>(frames * audio_channels);
+    if (audio_dither_enabled)
+        pcm_f32_to_s16_dither(src, static_cast<i16*>(samples), count, &audio_dither);
+    else
+        pcm_f32_to_s16(src, static_cast<i16*>(samples), count);
+}
+
+// Runs the callback at the requested rate for exactly the input the resampler
+// needs to fill `frames` device frames.
+static void audio_render_resampled(void* samples, i32 frames, f32* scratch)
+{
+    u32 needed = resampler_input_needed(&audio_resampler, static_cast<u32>(frames));
+    f32* input = audio_resample_input.data();
+    audio_clock.advance(needed);
+    if (audio_callback_f32)
+    {
+        audio_callback_f32(input, static_cast<i32>(needed), audio_userdata);
+    }
+    else
+    {
+        audio_callback(audio_resample_s16.data(), static_cast<i32>(needed), audio_userdata);
+        pcm_s16_to_f32(audio_resample_s16.data(), input, needed * audio_channels);
+    }
+
+    f32* output = audio_float_output ? static_cast<f32*>(samples) : scratch;
+    resampler_process(&audio_resampler, input, needed, output, static_cast<u32>(frames));
+    if (!audio_float_output)
+        audio_convert(scratch, samples, frames);
+}
+
+// Times the user callback against the period it has to fill. Float callbacks on an
+// S16 device render into `scratch`, which may be `samples` itself when it is float sized,
+// and are converted in one pass.
+static void audio_render(void* samples, i32 frames, f32* scratch)
+{
+    f64 start = get_time();
+    if (audio_resampling)
+    {
+        audio_render_resampled(samples, frames, scratch);
+    }
+    else if (!audio_callback_f32)
+    {
+        audio_clock.advance(frames);
+        audio_callback(static_cast<i16*>(samples), frames, audio_userdata);
+    }
+    else if (audio_float_output)
+    {
+        audio_clock.advance(frames);
+        audio_callback_f32(static_cast<f32*>(samples), frames, audio_userdata);
+    }
+    else
+    {
+        audio_clock.advance(frames);
+        audio_callback_f32(scratch, frames, audio_userdata);
+        audio_convert(scratch, samples, frames);
+    }
+    audio_telemetry.record_callback(get_time() - start, static_cast<f64>(frames) / audio_sample_rate);
+}
+
+static void audio_recover(i32 err)
+{
+    if (err == -EPIPE || err == -ESTRPIPE)
+        audio_telemetry.record_xrun();
+    audio_clock.resync();
+    snd_pcm_recover(pcm, err, 1);
+}
+
+// Samples the output delay once per period. Besides the histogram it publishes when the
+// last written frame reaches the DAC, which anchors audio_output_latency() and the audio clock.
+static void audio_record_delay()
+{
+    snd_pcm_uframes_t avail;
+    snd_htimestamp_t tstamp;
+    snd_pcm_sframes_t delay;
+    f64 time;
+
+    if (snd_pcm_htimestamp(pcm, &avail, &tstamp) == 0 && (tstamp.tv_sec != 0 || tstamp.tv_nsec != 0))
+    {
+        delay = audio_buffer_frames - static_cast<snd_pcm_sframes_t>(avail);
+        time = timespec_to_time(tstamp);
+    }
+    else if (snd_pcm_delay(pcm, &delay) == 0)
+        time = get_time();
+    else
+        return;
+
+    audio_telemetry.record_delay(delay);
+    f64 end_time = time + static_cast<f64>(delay) / audio_sample_rate;
+    audio_play_end_time.store(end_time, std::memory_order_release);
+    audio_clock.update(end_time);
+}
+
+// Touches every page of the stack the render loop may use, so it never faults growing it.
+static void __attribute__((noinline)) audio_prefault_stack()
+{
+    volatile u8 stack[AUDIO_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
+}
+
+// Runs on the audio thread before the first period. Every step is best effort.
+static void audio_thread_setup()
+{
+    // Filter and reverb tails decay into denormals, which are very slow on most cores.
+    dsp_flush_denormals();
+
+    if (audio_thread_policy != AUDIO_SCHED_DEFAULT)
+    {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = audio_thread_priority;
+        i32 policy = audio_thread_policy == AUDIO_SCHED_RR ? SCHED_RR : SCHED_FIFO;
+        i32 rc = pthread_setschedparam(pthread_self(), policy, &param);
+        if (rc != 0)
+            LOG_WARN("Failed to set audio thread real-time priority %d: %s. Using default scheduling.", audio_thread_priority, strerror(rc));
+        else
+            LOG_INFO("Audio thread running %s at priority %d", policy == SCHED_RR ? "SCHED_RR" : "SCHED_FIFO", audio_thread_priority);
+    }
+
+    // CPU_SET() does no bounds checking, so an out of range core would write past the set.
+    if (audio_thread_cpu >= CPU_SETSIZE || audio_thread_cpu >= sysconf(_SC_NPROCESSORS_CONF))
+        LOG_WARN("Not pinning audio thread: CPU %d does not exist", audio_thread_cpu);
+    else if (audio_thread_cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(audio_thread_cpu, &set);
+        i32 rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0)
+            LOG_WARN("Failed to pin audio thread to CPU %d: %s", audio_thread_cpu, strerror(rc));
+    }
+
+    audio_prefault_stack();
+
+    // Locks what is mapped now (audio buffers and the pre-faulted stack). MCL_FUTURE is
+    // avoided because later allocations would fail once RLIMIT_MEMLOCK is reached.
+    if (audio_lock_memory && mlockall(MCL_CURRENT) != 0)
+        LOG_WARN("Failed to lock audio memory: %s", strerror(errno));
+}
 
 static void audio_thread_func()
 {
-    std::vector<i16> buffer(audio_frame_count * audio_channels);
+    // Float sized, so any output format fits and float callbacks convert in place.
+    std::vector<f32> buffer(audio_frame_count * audio_channels);
+    audio_thread_setup();
+    PROFILE_THREAD("audio");
+    perf_counters_attach(PERF_THREAD_AUDIO);
 
     while (audio_running)
     {
-        audio_callback(buffer.data(), audio_frame_count, audio_userdata);
-        i32 rc = snd_pcm_writei(pcm, buffer.data(), audio_frame_count);
-        if (rc < 0) snd_pcm_prepare(pcm);
+        {
+            PROFILE_SCOPE("audio_period");
+            audio_drain_commands();
+            audio_render(buffer.data(), audio_frame_count, buffer.data());
+        }
+        snd_pcm_sframes_t rc = snd_pcm_writei(pcm, buffer.data(), audio_frame_count);
+        if (rc < 0)
+            audio_recover(static_cast<i32>(rc));
+        else
+            audio_record_delay();
     }
 
     snd_pcm_drain(pcm);
 }
 
-static bool audio_init(u32 sample_rate, i32 channels, i32 frame_count,
-    config_t::audio_callback_t cb, void* userdata)
+static void audio_poll_callback(u32 events, void* userdata)
 {
-    LOG_INFO("Initializing audio subsystem...");
-    if (cb == nullptr)
-    {
-        LOG_ERROR("Audio callback is null");
+    static_cast<struct pollfd*>(userdata)->revents = static_cast<short>(events);
+}
+
+// Waits on the PCM's poll descriptors and the shutdown eventfd together, so the thread
+// sleeps until a period is free instead of waking on a timeout.
+static bool audio_loop_init()
+{
+    audio_poll_count = snd_pcm_poll_descriptors(pcm, audio_poll_fds, AUDIO_POLL_FDS);
+    audio_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (audio_poll_count <= 0 || audio_wake_fd < 0 || !event_loop_init(&audio_loop) ||
+        !event_loop_add(&audio_loop, audio_wake_fd, EPOLLIN, event_loop_drain_wake, &audio_wake_fd))
         return false;
+
+    for (i32 i = 0; i < audio_poll_count; ++i)
+    {
+        if (!event_loop_add(&audio_loop, audio_poll_fds[i].fd, audio_poll_fds[i].events, audio_poll_callback, &audio_poll_fds[i]))
+            return false;
+    }
+    return true;
+}
+
+static void audio_loop_shutdown()
+{
+    event_loop_shutdown(&audio_loop);
+    if (audio_wake_fd >= 0)
+        close(audio_wake_fd);
+    audio_wake_fd = -1;
+    audio_poll_count = 0;
+}
+
+// Sleeps until the device can take more frames. Returns a negative error code for
+// audio_recover(), like snd_pcm_wait().
+static i32 audio_wait()
+{
+    if (audio_loop.epoll_fd < 0)
+        return snd_pcm_wait(pcm, 100);
+
+    if (event_loop_run(&audio_loop, -1) == 0)
+        return 0;
+
+    // Plugins such as dmix translate their descriptors' events here.
+    unsigned short revents = 0;
+    snd_pcm_poll_descriptors_revents(pcm, audio_poll_fds, static_cast<u32>(audio_poll_count), &revents);
+    for (i32 i = 0; i < audio_poll_count; ++i)
+        audio_poll_fds[i].revents = 0;
+    if (revents & POLLERR)
+    {
+        snd_pcm_state_t state = snd_pcm_state(pcm);
+        return state == SND_PCM_STATE_XRUN ? -EPIPE : state == SND_PCM_STATE_SUSPENDED ? -ESTRPIPE : 0;
     }
+    return 0;
+}
+
+// Renders straight into the driver ring buffer, one period at a time, whenever a
+// period of space is free. Saves the copy snd_pcm_writei() makes.
+static void audio_mmap_thread_func()
+{
+    const snd_pcm_uframes_t period = audio_frame_count;
+    const i32 frame_bytes = audio_channels * static_cast<i32>(audio_float_output ? sizeof(f32) : sizeof(i16));
+    audio_thread_setup();
+    PROFILE_THREAD("audio");
+    perf_counters_attach(PERF_THREAD_AUDIO);
 
-    i32 rc = snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, 0);
+    while (audio_running)
+    {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+        if (avail < 0)
+        {
+            audio_recover(static_cast<i32>(avail));
+            continue;
+        }
+
+        if (static_cast<snd_pcm_uframes_t>(avail) < period)
+        {
+            // The buffer is full; start playback if the start threshold was not reached yet.
+            if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED)
+                snd_pcm_start(pcm);
+
+            i32 rc = audio_wait();
+            if (rc < 0)
+                audio_recover(rc);
+            continue;
+        }
+
+        PROFILE_SCOPE("audio_period");
+        audio_drain_commands();
+
+        snd_pcm_uframes_t remaining = period;
+        while (remaining > 0)
+        {
+            const snd_pcm_channel_area_t* areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t frames = remaining;
+            i32 rc = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+            if (rc < 0)
+            {
+                audio_recover(rc);
+                break;
+            }
+
+            // Interleaved access has a single area; the period may wrap the ring in two pieces.
+            u8* base = static_cast<u8*>(areas[0].addr) + areas[0].first / 8;
+            audio_render(base + offset * frame_bytes, static_cast<i32>(frames), audio_float_buffer.data());
+
+            snd_pcm_sframes_t committed = snd_pcm_mmap_commit(pcm, offset, frames);
+            if (committed < 0 || static_cast<snd_pcm_uframes_t>(committed) != frames)
+            {
+                audio_recover(committed < 0 ? static_cast<i32>(committed) : -EPIPE);
+                break;
+            }
+            remaining -= frames;
+        }
+
+        audio_record_delay();
+    }
+
+    snd_pcm_drain(pcm);
+}
+
+static bool audio_init(const config_t& config)
+{
+    LOG_INFO("Initializing audio subsystem...");
+    u32 sample_rate = config.audio_sample_rate;
+    i32 channels = config.audio_channels;
+    i32 frame_count = config.audio_frame_count;
+
+    i32 rc = snd_pcm_open(&pcm, config.audio_device, SND_PCM_STREAM_PLAYBACK, 0);
     if (rc < 0)
     {
-        LOG_ERROR("Failed to open audio device");
+        LOG_ERROR("Failed to open audio device %s: %s", config.audio_device, snd_strerror(rc));
         return false;
     }
 
     snd_pcm_hw_params_t* hw;
     snd_pcm_hw_params_alloca(&hw);
     snd_pcm_hw_params_any(pcm, hw);
-    snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
-    snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16_LE);
+
+    audio_mmap = config.audio_mmap && snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+    if (!audio_mmap)
+    {
+        if (config.audio_mmap)
+            LOG_WARN("Audio device does not support mmap access, falling back to writes");
+        snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
+    // Float callbacks (and the built-in mixer) skip conversion entirely when the device takes floats.
+    bool float_callback = config.audio_callback_f32 != nullptr || config.audio_callback == nullptr;
+    audio_float_output = float_callback && config.audio_float_output &&
+        snd_pcm_hw_params_test_format(pcm, hw, SND_PCM_FORMAT_FLOAT_LE) == 0;
+    snd_pcm_hw_params_set_format(pcm, hw, audio_float_output ? SND_PCM_FORMAT_FLOAT_LE : SND_PCM_FORMAT_S16_LE);
     snd_pcm_hw_params_set_channels(pcm, hw, channels);
+    // With our own resampler, keep ALSA's plug layer from converting behind our back
+    // so the rate below is one the hardware runs at natively.
+    if (config.audio_resample)
+        snd_pcm_hw_params_set_rate_resample(pcm, hw, 0);
     snd_pcm_hw_params_set_rate_near(pcm, hw, &sample_rate, nullptr);
 
+    // A target latency sizes the whole buffer and splits it into the requested periods.
+    u32 periods = config.audio_period_count > 1 ? config.audio_period_count : 2;
     snd_pcm_uframes_t period = frame_count;
-    snd_pcm_uframes_t buffer_size = period * 4;
+    if (config.audio_target_latency_ms > 0.0)
+    {
+        snd_pcm_uframes_t target = static_cast<snd_pcm_uframes_t>(config.audio_target_latency_ms * sample_rate / 1000.0);
+        period = target / periods > 16 ? target / periods : 16;
+    }
+    snd_pcm_uframes_t buffer_size = period * periods;
     snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, nullptr);
     snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &buffer_size);
 
     rc = snd_pcm_hw_params(pcm, hw);
     ASSERT(rc == 0, "Failed to set audio hardware params");
 
+    // The _near setters only hint; render with whatever the driver settled on.
+    snd_pcm_hw_params_get_rate(hw, &sample_rate, nullptr);
+    snd_pcm_hw_params_get_period_size(hw, &period, nullptr);
+    snd_pcm_hw_params_get_buffer_size(hw, &buffer_size);
+    frame_count = static_cast<i32>(period);
+    if (sample_rate != config.audio_sample_rate)
+        LOG_WARN("Audio device runs at %u Hz instead of the requested %u Hz%s", sample_rate, config.audio_sample_rate,
+            config.audio_resample ? ", resampling" : "");
+    LOG_INFO("Audio buffer: %d frames x %lu periods at %u Hz %s (%.2f ms)", frame_count,
+        static_cast<unsigned long>(buffer_size / period), sample_rate, audio_float_output ? "FLOAT_LE" : "S16_LE",
+        buffer_size * 1000.0 / sample_rate);
+
+    // Monotonic timestamps let audio_output_latency() extrapolate between periods.
+    snd_pcm_sw_params_t* sw;
+    snd_pcm_sw_params_alloca(&sw);
+    snd_pcm_sw_params_current(pcm, sw);
+    snd_pcm_sw_params_set_tstamp_mode(pcm, sw, SND_PCM_TSTAMP_ENABLE);
+    snd_pcm_sw_params_set_tstamp_type(pcm, sw, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+    if (audio_mmap)
+    {
+        // Wake once a whole period is free, and start once the buffer has been filled.
+        snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+        snd_pcm_sw_params_set_start_threshold(pcm, sw, buffer_size - buffer_size % period);
+    }
+    snd_pcm_sw_params(pcm, sw);
+
     snd_pcm_prepare(pcm);
 
     audio_sample_rate = sample_rate;
     audio_channels = channels;
     audio_frame_count = frame_count;
-    audio_callback = cb;
-    audio_userdata = userdata;
+    audio_buffer_frames = static_cast<i32>(buffer_size);
+    audio_period_count = static_cast<i32>(buffer_size / period);
+    audio_play_end_time.store(0.0);
+    audio_callback = config.audio_callback;
+    audio_callback_f32 = config.audio_callback_f32;
+    audio_userdata = config.audio_userdata;
+    audio_dither_enabled = config.audio_dither;
+
+    // Callbacks and the mixer keep running at the requested rate; see audio_render_resampled().
+    u32 client_rate = sample_rate;
+    i32 client_frames = frame_count;
+    audio_resampling = config.audio_resample && sample_rate != config.audio_sample_rate &&
+        resampler_init(&audio_resampler, config.audio_sample_rate, sample_rate, channels, config.audio_resample_quality,
+            static_cast<u32>(static_cast<u64>(frame_count) * config.audio_sample_rate / sample_rate) + 64);
+    if (audio_resampling)
+    {
+        client_rate = config.audio_sample_rate;
+        client_frames = static_cast<i32>(audio_resampler.capacity);
+        audio_resample_input.assign(client_frames * channels, 0.0f);
+        audio_resample_s16.assign(float_callback ? 0 : client_frames * channels, 0);
+    }
+    audio_float_buffer.assign(float_callback || audio_resampling ? frame_count * channels : 0, 0.0f);
+    audio_command_callback = config.audio_command_callback;
+    audio_thread_policy = config.audio_thread_policy;
+    audio_thread_priority = config.audio_thread_priority;
+    audio_thread_cpu = config.audio_thread_cpu;
+    audio_lock_memory = config.audio_lock_memory;
+    audio_telemetry.reset(frame_count * 1000.0 / sample_rate, static_cast<u32>(buffer_size));
+    audio_clock.reset(client_rate);
+
+    // Without a user callback the built-in mixer renders the output.
+    audio_mixer_enabled = audio_callback == nullptr && audio_callback_f32 == nullptr;
+    if (audio_mixer_enabled)
+    {
+        if (!mixer_init(&audio_mixer, client_rate, channels, client_frames, config.audio_voices, config.audio_buses))
+        {
+            audio_mixer_enabled = false;
+            snd_pcm_close(pcm);
+            pcm = nullptr;
+            return false;
+        }
+        audio_callback_f32 = mixer_audio_callback_f32;
+        audio_userdata = &audio_mixer;
+    }
+
+    if (audio_mmap && !audio_loop_init())
+    {
+        LOG_WARN("Audio event loop unavailable, waiting with snd_pcm_wait()");
+        audio_loop_shutdown();
+    }
 
     audio_running = true;
-    audio_thread = std::thread(audio_thread_func);
+    audio_thread = std::thread(audio_mmap ? audio_mmap_thread_func : audio_thread_func);
 
-    LOG_INFO("Audio subsystem initialized");
+    LOG_INFO("Audio subsystem initialized (%s access)", audio_mmap ? "mmap" : "rw");
     return true;
 }
 
@@ -278,17 +985,48 @@ static void audio_shutdown()
     if (!audio_running) return;
 
     audio_running = false;
+    if (audio_wake_fd >= 0)
+        event_loop_wake(audio_wake_fd);
     if (audio_thread.joinable())
         audio_thread.join();
+    audio_loop_shutdown();
 
     snd_pcm_close(pcm);
     pcm = nullptr;
+
+    if (audio_mixer_enabled)
+    {
+        mixer_shutdown(&audio_mixer);
+        audio_mixer_enabled = false;
+    }
 }
 
 // Input
-static i32 gp_fd;
-static bool buttons[GP_BTN_COUNT] = { false };
-static f32 axes[GP_AXIS_COUNT] = { 0.0f };
+#define INPUT_READ_BATCH 64
+#define INPUT_DEVICE_DIR "/dev/input"
+#define INPUT_NOTIFY_BUFFER 1024
+
+// Cached EVIOCGABS range of a mapped axis, folded into a multiply-add.
+struct input_axis_t
+{
+    f32 scale;
+    f32 offset;
+    f32 flat;		// Normalized dead zone around the center
+    i32 fuzz;		// Noise the kernel filters out of events
+    i32 value;		// Last raw value, so resyncs filter the same way
+};
+
+static i32 gp_fd = -1;
+static char gp_name[NAME_MAX + 1];			// Entry under INPUT_DEVICE_DIR, for hot unplug
+static const char* gp_path = nullptr;		// config_t::input_device
+static input_axis_t gp_axes[GP_AXIS_COUNT];
+static bool input_resync_pending = false;
+static std::thread input_thread;
+static std::atomic<bool> input_thread_running(false);
+static event_loop_t input_loop;
+static event_loop_t* input_reader_loop = nullptr;		// input_loop, or device_loop without a thread
+static i32 input_wake_fd = -1;
+static i32 input_notify_fd = -1;
 
 static i32 map_button(i32 code)
 {
@@ -327,86 +1065,541 @@ static i32 map_axis(i32 code)
     }
 }
 
-static f32 normalize_axis(i32 value, i32 min, i32 max)
+static f32 normalize_axis(i32 axis, i32 value)
 {
-    return (static_cast<f32>(value - min) / (max - min)) * 2.0f - 1.0f;
+    input_axis_t& info = gp_axes[axis];
+    info.value = value;
+    f32 v = value * info.scale + info.offset;
+    return fabsf(v) > info.flat ? v : 0.0f;
 }
 
-static void input_poll()
+static void input_cache_axes(i32 fd)
 {
-    struct input_event ev;
-    while (read(gp_fd, &ev, sizeof(ev)) > 0)
+    for (i32 code = 0; code <= ABS_MAX; ++code)
     {
-        if (ev.type == EV_KEY)
+        i32 a = map_axis(code);
+        if (a < 0)
+            continue;
+
+        // Drivers that report no usable range get the R36S stick's.
+        struct input_absinfo absinfo;
+        if (ioctl(fd, EVIOCGABS(code), &absinfo) != 0 || absinfo.maximum <= absinfo.minimum)
         {
-            i32 b = map_button(ev.code);
-            if (b >= 0) buttons[b] = (ev.value != 0);
+            memset(&absinfo, 0, sizeof(absinfo));
+            absinfo.minimum = -1800;
+            absinfo.maximum = 1800;
         }
-        else if (ev.type == EV_ABS)
+
+        input_axis_t& info = gp_axes[a];
+        info.scale = 2.0f / (absinfo.maximum - absinfo.minimum);
+        info.offset = -1.0f - absinfo.minimum * info.scale;
+        info.flat = absinfo.flat * info.scale;
+        info.fuzz = absinfo.fuzz;
+        info.value = absinfo.minimum + (absinfo.maximum - absinfo.minimum) / 2;		// Where the game thread's 0 is
+    }
+}
+
+static bool test_bit(const u8* bits, i32 bit)
+{
+    return (bits[bit / 8] >> (bit % 8)) & 1;
+}
+
+static void input_describe(i32 fd, char* name, size_t name_size, input_device_desc_t* desc)
+{
+    u8 key_bits[KEY_MAX / 8 + 1];
+    u8 abs_bits[ABS_MAX / 8 + 1];
+    u8 prop_bits[INPUT_PROP_MAX / 8 + 1];
+    memset(key_bits, 0, sizeof(key_bits));
+    memset(abs_bits, 0, sizeof(abs_bits));
+    memset(prop_bits, 0, sizeof(prop_bits));
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits);
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits);
+    ioctl(fd, EVIOCGPROP(sizeof(prop_bits)), prop_bits);
+    if (ioctl(fd, EVIOCGNAME(name_size - 1), name) < 0)
+        name[0] = 0;
+    name[name_size - 1] = 0;
+
+    memset(desc, 0, sizeof(*desc));
+    desc->name = name;
+    for (i32 code = 0; code <= KEY_MAX; ++code)
+    {
+        if (!test_bit(key_bits, code))
+            continue;
+        i32 b = map_button(code);
+        if (b >= 0)
+            desc->buttons |= 1u << b;
+        if (code < BTN_MISC)
+            desc->keys++;
+        if (code >= BTN_GAMEPAD && code <= BTN_THUMBR)
+            desc->gamepad = true;
+    }
+    for (i32 code = 0; code <= ABS_MAX; ++code)
+    {
+        i32 a = map_axis(code);
+        if (a >= 0 && test_bit(abs_bits, code))
+            desc->axes |= 1u << a;
+    }
+    desc->accelerometer = test_bit(prop_bits, INPUT_PROP_ACCELEROMETER);
+}
+
+static f64 timeval_to_time(const struct timeval& tv)
+{
+    struct timespec ts;
+    ts.tv_sec = tv.tv_sec;
+    ts.tv_nsec = static_cast<long>(tv.tv_usec) * 1000;
+    return timespec_to_time(ts);
+}
+
+// After a kernel buffer overrun the event stream is incomplete, so re-read the current
+// levels and queue them as events; unchanged controls produce no edges.
+static void input_resync(f64 time)
+{
+    u8 keys[KEY_MAX / 8 + 1];
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(gp_fd, EVIOCGKEY(sizeof(keys)), keys) >= 0)
+    {
+        for (i32 code = 0; code <= KEY_MAX; ++code)
         {
-            i32 a = map_axis(ev.code);
-            if (a >= 0) axes[a] = normalize_axis(ev.value, -1800, 1800);
+            i32 b = map_button(code);
+            if (b >= 0)
+                input_queue_push({ time, INPUT_EVENT_BUTTON, static_cast<u8>(b), (keys[code / 8] >> (code % 8)) & 1 ? 1.0f : 0.0f });
         }
     }
+
+    for (i32 code = 0; code <= ABS_MAX; ++code)
+    {
+        i32 a = map_axis(code);
+        struct input_absinfo absinfo;
+        if (a < 0 || ioctl(gp_fd, EVIOCGABS(code), &absinfo) < 0)
+            continue;
+        i32 change = absinfo.value - gp_axes[a].value;
+        if (change > gp_axes[a].fuzz || -change > gp_axes[a].fuzz)
+            input_queue_push({ time, INPUT_EVENT_AXIS, static_cast<u8>(a), normalize_axis(a, absinfo.value) });
+    }
 }
 
-static bool input_init()
+// Drains the device a batch of events per read() and queues the mapped ones with
+// their kernel timestamps.
+static void input_poll()
 {
-    LOG_INFO("Opening input device...");
-    gp_fd = open("/dev/input/event2", O_RDONLY | O_NONBLOCK);
     if (gp_fd < 0)
+        return;
+    PROFILE_SCOPE("input_poll");
+
+    struct input_event events[INPUT_READ_BATCH];
+    for (;;)
     {
-        LOG_ERROR("Failed to open input device");
+        ssize_t bytes = read(gp_fd, events, sizeof(events));
+        if (bytes <= 0)
+            break;
+
+        u32 count = static_cast<u32>(bytes / sizeof(struct input_event));
+        for (u32 i = 0; i < count; ++i)
+        {
+            const struct input_event& ev = events[i];
+            if (ev.type == EV_SYN)
+            {
+                if (ev.code == SYN_DROPPED)
+                {
+                    // Everything up to the next report is unreliable.
+                    input_queue_dropped(1);
+                    input_resync_pending = true;
+                }
+                else if (ev.code == SYN_REPORT && input_resync_pending)
+                {
+                    input_resync_pending = false;
+                    input_resync(timeval_to_time(ev.time));
+                }
+                continue;
+            }
+            if (input_resync_pending)
+                continue;
+
+            if (ev.type == EV_KEY)
+            {
+                i32 b = map_button(ev.code);
+                if (b >= 0)
+                    input_queue_push({ timeval_to_time(ev.time), INPUT_EVENT_BUTTON, static_cast<u8>(b), ev.value != 0 ? 1.0f : 0.0f });
+            }
+            else if (ev.type == EV_ABS)
+            {
+                i32 a = map_axis(ev.code);
+                if (a >= 0)
+                    input_queue_push({ timeval_to_time(ev.time), INPUT_EVENT_AXIS, static_cast<u8>(a), normalize_axis(a, ev.value) });
+            }
+        }
+
+        if (count < INPUT_READ_BATCH)
+            break;
+    }
+}
+
+// Blocks on the device and queues events as they arrive, so their timestamps are
+// read within microseconds instead of once per frame.
+static void input_thread_func()
+{
+    PROFILE_THREAD("input");
+    while (input_thread_running.load(std::memory_order_relaxed))
+        event_loop_run(&input_loop, -1);
+}
+
+static void input_close()
+{
+    if (gp_fd < 0)
+        return;
+
+    event_loop_remove(input_reader_loop, gp_fd);
+    close(gp_fd);
+    gp_fd = -1;
+    gp_name[0] = 0;
+    input_resync_pending = false;
+
+    // Nothing stays held on a device that is gone.
+    f64 time = get_time();
+    for (u32 b = 0; b < GP_BTN_COUNT; ++b)
+        input_queue_push({ time, INPUT_EVENT_BUTTON, static_cast<u8>(b), 0.0f });
+    for (u32 a = 0; a < GP_AXIS_COUNT; ++a)
+        input_queue_push({ time, INPUT_EVENT_AXIS, static_cast<u8>(a), 0.0f });
+}
+
+static void input_ready_callback(u32 events, void*)
+{
+    // A hung up device stays ready forever; stop waiting on it.
+    if (events & (EPOLLHUP | EPOLLERR))
+    {
+        LOG_WARN("Input device disconnected");
+        input_close();
+        return;
+    }
+    input_poll();
+}
+
+// Opens config_t::input_device, or the best scoring gamepad under INPUT_DEVICE_DIR.
+static bool input_open()
+{
+    char path[PATH_MAX];
+    char name[128];
+    i32 best_score = -1;
+    i32 fd = -1;
+
+    DIR* dir = gp_path ? nullptr : opendir(INPUT_DEVICE_DIR);
+    if (gp_path)
+    {
+        fd = open(gp_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        const char* slash = strrchr(gp_path, '/');
+        snprintf(gp_name, sizeof(gp_name), "%s", slash ? slash + 1 : gp_path);
+    }
+    while (dir)
+    {
+        struct dirent* entry = readdir(dir);
+        if (!entry)
+            break;
+        if (strncmp(entry->d_name, "event", 5) != 0)
+            continue;
+
+        snprintf(path, sizeof(path), INPUT_DEVICE_DIR "/%s", entry->d_name);
+        i32 candidate = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (candidate < 0)
+            continue;
+
+        input_device_desc_t desc;
+        input_describe(candidate, name, sizeof(name), &desc);
+        i32 score = input_score_device(desc);
+        if (score > best_score)
+        {
+            if (fd >= 0)
+                close(fd);
+            fd = candidate;
+            best_score = score;
+            snprintf(gp_name, sizeof(gp_name), "%s", entry->d_name);
+        }
+        else
+        {
+            close(candidate);
+        }
+    }
+    if (dir)
+        closedir(dir);
+
+    if (fd < 0)
+    {
+        gp_name[0] = 0;
         return false;
     }
 
-    LOG_INFO("Input device initialized");
+    input_device_desc_t desc;
+    input_describe(fd, name, sizeof(name), &desc);
+    input_cache_axes(fd);
+
+    // Timestamp events on get_time()'s clock instead of wall time.
+    i32 clock = CLOCK_MONOTONIC;
+    if (ioctl(fd, EVIOCSCLOCKID, &clock) != 0)
+        LOG_WARN("Input timestamps stay on the realtime clock; latency stats will be off");
+
+    if (!event_loop_add(input_reader_loop, fd, EPOLLIN, input_ready_callback, nullptr))
+    {
+        LOG_ERROR("Failed to add the input device to the event loop");
+        close(fd);
+        gp_name[0] = 0;
+        return false;
+    }
+
+    gp_fd = fd;
+    LOG_INFO("Using input device %s/%s \"%s\"", INPUT_DEVICE_DIR, gp_name, name);
+
+    // Pick up whatever is already held.
+    input_resync(get_time());
     return true;
 }
 
+// Device nodes appear before udev grants access to them, so both creation and
+// attribute changes are worth a rescan while no gamepad is open.
+static void input_notify_callback(u32, void*)
+{
+    alignas(struct inotify_event) char buffer[INPUT_NOTIFY_BUFFER];
+    bool rescan = false;
+    for (;;)
+    {
+        ssize_t bytes = read(input_notify_fd, buffer, sizeof(buffer));
+        if (bytes <= 0)
+            break;
+
+        for (char* p = buffer; p < buffer + bytes;)
+        {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0 || strncmp(event->name, "event", 5) != 0)
+                continue;
+
+            if ((event->mask & IN_DELETE) && strcmp(event->name, gp_name) == 0)
+            {
+                LOG_WARN("Input device %s removed", event->name);
+                input_close();
+            }
+            else if (event->mask & (IN_CREATE | IN_ATTRIB))
+            {
+                rescan = true;
+            }
+        }
+    }
+
+    if (rescan && gp_fd < 0)
+        input_open();
+}
+
+static bool input_thread_init()
+{
+    input_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (input_wake_fd < 0 || !event_loop_init(&input_loop) ||
+        !event_loop_add(&input_loop, input_wake_fd, EPOLLIN, event_loop_drain_wake, &input_wake_fd))
+    {
+        LOG_WARN("Failed to create the input thread event loop");
+        return false;
+    }
+    return true;
+}
+
+static void input_thread_shutdown()
+{
+    if (input_thread.joinable())
+    {
+        input_thread_running.store(false, std::memory_order_relaxed);
+        event_loop_wake(input_wake_fd);
+        input_thread.join();
+    }
+
+    if (input_wake_fd >= 0)
+        close(input_wake_fd);
+    input_wake_fd = -1;
+}
+
+static bool input_init(const config_t& config)
+{
+    LOG_INFO("Opening input device...");
+    input_queue_reset();
+    gp_path = config.input_device;
+
+    input_reader_loop = &device_loop;
+    if (config.input_thread)
+    {
+        if (input_thread_init())
+        {
+            input_reader_loop = &input_loop;
+        }
+        else
+        {
+            LOG_WARN("Input thread unavailable, reading input on the game thread instead");
+            input_thread_shutdown();
+            event_loop_shutdown(&input_loop);
+        }
+    }
+
+    input_notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (input_notify_fd >= 0 && (inotify_add_watch(input_notify_fd, INPUT_DEVICE_DIR, IN_CREATE | IN_ATTRIB | IN_DELETE) < 0 ||
+        !event_loop_add(input_reader_loop, input_notify_fd, EPOLLIN, input_notify_callback, nullptr)))
+    {
+        close(input_notify_fd);
+        input_notify_fd = -1;
+    }
+    if (input_notify_fd < 0)
+        LOG_WARN("Input hotplug unavailable");
+
+    bool found = input_open();
+    if (!found)
+        LOG_WARN("No gamepad found%s", input_notify_fd >= 0 ? ", waiting for one to be connected" : "");
+
+    // The thread owns the device from here on, hotplug included.
+    if (input_reader_loop == &input_loop)
+    {
+        input_thread_running.store(true, std::memory_order_relaxed);
+        input_thread = std::thread(input_thread_func);
+    }
+
+    LOG_INFO("Input device initialized");
+    return found || input_notify_fd >= 0;
+}
+
 static void input_shutdown()
 {
-    close(gp_fd);
+    input_thread_shutdown();
+    if (gp_fd >= 0)
+    {
+        event_loop_remove(input_reader_loop, gp_fd);
+        close(gp_fd);
+    }
+    gp_fd = -1;
+
+    if (input_notify_fd >= 0)
+    {
+        event_loop_remove(input_reader_loop, input_notify_fd);
+        close(input_notify_fd);
+    }
+    input_notify_fd = -1;
+    event_loop_shutdown(&input_loop);
 }
 
+// Frame limiter
+// Sleeps on an absolute deadline, so time spent waking up is not added to the next
+// frame, then spins the last FRAME_LIMITER_SPIN_NS on the clock.
+#define FRAME_LIMITER_SPIN_NS 500000ull
+
+static frame_limiter_t frame_limiter;
+
+static void frame_limiter_wait()
+{
+    PROFILE_SCOPE("frame_limiter_wait");
+    u64 now = get_time_ns();
+    u64 deadline = frame_limiter.next_deadline(now);
+    if (deadline == 0)
+        return;
+
+    if (deadline > now + frame_limiter.spin_ns)
+    {
+        u64 wake = deadline - frame_limiter.spin_ns;
+        struct timespec ts;
+        ts.tv_sec = device_start_ts.tv_sec + static_cast<time_t>(wake / 1000000000ull);
+        ts.tv_nsec = device_start_ts.tv_nsec + static_cast<long>(wake % 1000000000ull);
+        if (ts.tv_nsec >= 1000000000l)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000l;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+    }
+
+    u64 spin_start = get_time_ns();
+    while ((now = get_time_ns()) < deadline) {}
+    frame_limiter.record(deadline, now, now - spin_start);
+}
+
+// Loader
+static f64 loader_upload_budget_ms = 0.0;
+
 // Public API
 bool init(const config_t& config)
 {
-    if (!display_init(config.display_vsync))
+    clock_gettime(CLOCK_MONOTONIC, &device_start_ts);
+    PROFILE_THREAD("main");
+    perf_counters_init(config.perf_counters);
+
+    if (!display_init(config.display_vsync, config.display_upload_context))
     {
         LOG_ERROR("Display initialization failed. A functional display is required for operation.");
         return false;
     }
 
-    if (!audio_init(config.audio_sample_rate, config.audio_channels,
-        config.audio_frame_count, config.audio_callback, config.audio_userdata))
+    if (!audio_init(config))
         LOG_WARN("Audio initialization failed. Continuing without audio support.");
 
-    if (!input_init())
+    if (!input_init(config))
         LOG_WARN("Input system initialization failed. Continuing without input support.");
 
+    bool background_uploads = display_egl_upload_context != EGL_NO_CONTEXT;
+    if (config.loader_threads > 0 && !loader_init(config.loader_threads, background_uploads))
+        LOG_WARN("Asset loader initialization failed. Continuing without async loading.");
+    loader_upload_budget_ms = config.loader_upload_budget_ms;
+    frame_limiter.reset(config.display_frame_cap, config.display_paused_cap, FRAME_LIMITER_SPIN_NS);
+    frame_stats_init();
+
     LOG_INFO("Device initialization completed successfully.");
     return true;
 }
 
 void shutdown()
 {
+    input_record_stop();
+    input_replay_stop();
+    frame_stats_shutdown();
+    loader_shutdown();
     display_shutdown();
     audio_shutdown();
     input_shutdown();
+    perf_counters_shutdown();
 
     LOG_INFO("Device shutdown complete");
 }
 
 bool begin_frame()
 {
+    frame_limiter_wait();
+    PROFILE_SCOPE("begin_frame");
+    frame_stats_begin(get_time_ns());
+    perf_counters_begin();
+    event_loop_run(&device_loop, 0);
+    input_queue_update(get_time());
+    loader_update(loader_upload_budget_ms);
     return !display_should_close;
 }
 
 void end_frame()
 {
-    input_poll();
+    PROFILE_SCOPE("end_frame");
+    perf_counters_end();
+    frame_stats_present(get_time_ns());
     display_present();
+    frame_stats_end(get_time_ns());
+    input_queue_presented(display_present_time);
+}
+
+void set_paused(bool paused)
+{
+    frame_limiter.set_paused(paused);
+}
+
+void get_frame_limiter_stats(frame_limiter_stats_t* stats)
+{
+    frame_limiter.get_stats(stats);
+}
+
+void get_perf_stats(perf_stats_t* stats)
+{
+    perf_counters_get(stats);
+}
+
+void input_latch()
+{
+    event_loop_run(&device_loop, 0);
+    input_queue_latch(get_time());
 }
 
 void close()
@@ -420,20 +1613,80 @@ void screen_size(i32* width, i32* height)
     *height = display_drm_mode.vdisplay;
 }
 
-f64 get_time()
+mixer_t* get_mixer()
 {
-    struct timespec cur_ts;
-    clock_gettime(CLOCK_MONOTONIC, &cur_ts);
-    return (cur_ts.tv_sec - device_start_ts.tv_sec) +
-        (cur_ts.tv_nsec - device_start_ts.tv_nsec) * 1e-9;
+    return audio_mixer_enabled ? &audio_mixer : nullptr;
 }
 
-bool is_button_pressed(u8 btn)
+bool audio_post(const audio_command_t& command)
 {
-    return buttons[btn];
+    return audio_commands.push(command);
 }
 
-f32 get_axis_value(u8 axis)
+void audio_get_stats(audio_stats_t* stats)
 {
-    return axes[axis];
+    audio_telemetry.snapshot(stats);
+}
+
+bool audio_get_info(audio_info_t* info)
+{
+    if (!audio_running)
+        return false;
+
+    info->sample_rate = audio_sample_rate;
+    info->channels = audio_channels;
+    info->period_frames = audio_frame_count;
+    info->period_count = audio_period_count;
+    info->buffer_frames = audio_buffer_frames;
+    info->mmap = audio_mmap;
+    info->float_output = audio_float_output;
+    info->resampling = audio_resampling;
+    return true;
+}
+
+f64 audio_output_latency()
+{
+    f64 latency = audio_play_end_time.load(std::memory_order_acquire) - get_time();
+    return latency > 0.0 ? latency : 0.0;
+}
+
+u64 audio_get_frame()
+{
+    return audio_clock.time_to_frame(get_time());
+}
+
+f64 audio_frame_to_time(u64 frame)
+{
+    return audio_clock.frame_to_time(frame);
+}
+
+u64 audio_time_to_frame(f64 time)
+{
+    return audio_clock.time_to_frame(time);
+}
+
+bool bind_upload_context()
+{
+    if (display_egl_upload_context == EGL_NO_CONTEXT)
+        return false;
+    return eglMakeCurrent(display_egl_display, display_egl_upload_surface, display_egl_upload_surface, display_egl_upload_context);
+}
+
+void unbind_upload_context()
+{
+    eglMakeCurrent(display_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+u64 get_time_ns()
+{
+    struct timespec cur_ts;
+    clock_gettime(CLOCK_MONOTONIC, &cur_ts);
+    return static_cast<u64>(cur_ts.tv_sec - device_start_ts.tv_sec) * 1000000000ull + cur_ts.tv_nsec - device_start_ts.tv_nsec;
+}
+
+f64 get_time()
+{
+    struct timespec cur_ts;
+    clock_gettime(CLOCK_MONOTONIC, &cur_ts);
+    return timespec_to_time(cur_ts);
 }
\ No newline at end of file
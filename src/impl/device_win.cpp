@@ -1,4 +1,12 @@
 #include "device.hpp"
+#include "dsp.hpp"
+#include "loader.hpp"
+#include "mixer.hpp"
+#include "pcm.hpp"
+#include "ring.hpp"
+#include "audio_stats.hpp"
+#include "audio_clock.hpp"
+#include "profiler.hpp"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -13,8 +21,9 @@
 
 // Display
 static GLFWwindow* display_window = nullptr;
+static GLFWwindow* display_upload_window = nullptr;
 
-static bool display_init(i32 width, i32 height, const char* title)
+static bool display_init(i32 width, i32 height, const char* title, bool upload_context)
 {
     LOG_INFO("Initializing GLFW...");
     if (!glfwInit())
@@ -34,12 +43,28 @@ static bool display_init(i32 width, i32 height, const char* title)
     if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)))
         LOG_ERROR("Failed to initialize GLAD");
 
+    if (upload_context)
+    {
+        // A hidden window is the only way to get a second, sharing context from GLFW.
+        LOG_INFO("Creating shared upload context...");
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        display_upload_window = glfwCreateWindow(1, 1, "", nullptr, display_window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!display_upload_window)
+            LOG_WARN("Failed to create shared upload context. Continuing without background GPU uploads.");
+    }
+
     LOG_INFO("GLFW window and OpenGL context initialized successfully.");
     return true;
 }
 
 static void display_shutdown()
 {
+    if (display_upload_window)
+    {
+        glfwDestroyWindow(display_upload_window);
+        display_upload_window = nullptr;
+    }
     if (display_window)
     {
         glfwDestroyWindow(display_window);
@@ -50,25 +75,85 @@ static void display_shutdown()
 
 // Audio
 #define AUDIO_BUFFERS 3
+#define AUDIO_COMMAND_CAPACITY 256
 static u32 audio_sample_rate;
 static i32 audio_channels;
 static i32 audio_frame_count;
 static std::thread audio_thread;
 static std::atomic<bool> audio_running(false);
 static config_t::audio_callback_t audio_callback;
+static config_t::audio_callback_f32_t audio_callback_f32;
+static bool audio_dither_enabled = true;
+static pcm_dither_t audio_dither;
+static std::vector<f32> audio_float_buffer;
 static void* audio_userdata;
+static config_t::audio_command_callback_t audio_command_callback;
+static spsc_ring_t<audio_command_t, AUDIO_COMMAND_CAPACITY> audio_commands;
+static mixer_t audio_mixer;
+static bool audio_mixer_enabled = false;
+static u8 audio_thread_policy = AUDIO_SCHED_DEFAULT;
+static i32 audio_thread_cpu = -1;
+static audio_telemetry_t audio_telemetry;
+static audio_clock_t audio_clock;
 
 static std::vector<std::vector<i16>> audio_buffers(AUDIO_BUFFERS);
 static int audio_current_buffer = 0;
 static HWAVEOUT audio_hWaveOut = nullptr;
 static WAVEHDR audio_waveHdrs[AUDIO_BUFFERS];
 
+static void audio_drain_commands()
+{
+    audio_command_t command;
+    while (audio_commands.pop(&command))
+    {
+        if (audio_command_callback)
+            audio_command_callback(command, audio_userdata);
+    }
+}
+
+// Windows has no user-selectable real-time policy; both map to time critical priority.
+static void audio_thread_setup()
+{
+    dsp_flush_denormals();
+
+    if (audio_thread_policy != AUDIO_SCHED_DEFAULT && !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+        LOG_WARN("Failed to raise audio thread priority (error %lu)", static_cast<unsigned long>(GetLastError()));
+
+    if (audio_thread_cpu >= 0 && !SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << audio_thread_cpu))
+        LOG_WARN("Failed to pin audio thread to CPU %d", audio_thread_cpu);
+}
+
 static void audio_thread_func()
 {
+    audio_thread_setup();
+    PROFILE_THREAD("audio");
+    perf_counters_attach(PERF_THREAD_AUDIO);
+
     while (audio_running)
     {
         // Fill current buffer
-        audio_callback(audio_buffers[audio_current_buffer].data(), audio_frame_count, audio_userdata);
+        {
+            PROFILE_SCOPE("audio_period");
+            audio_drain_commands();
+            f64 start = get_time();
+            i16* samples = audio_buffers[audio_current_buffer].data();
+            if (audio_callback_f32)
+            {
+                // waveOut only gets S16 here, so float callbacks always convert.
+                u32 count = static_cast<u32>(audio_frame_count * audio_channels);
+                audio_callback_f32(audio_float_buffer.data(), audio_frame_count, audio_userdata);
+                if (audio_dither_enabled)
+                    pcm_f32_to_s16_dither(audio_float_buffer.data(), samples, count, &audio_dither);
+                else
+                    pcm_f32_to_s16(audio_float_buffer.data(), samples, count);
+            }
+            else
+            {
+                audio_callback(samples, audio_frame_count, audio_userdata);
+            }
+            audio_telemetry.record_callback(get_time() - start, static_cast<f64>(audio_frame_count) / audio_sample_rate);
+            audio_clock.advance(static_cast<u32>(audio_frame_count));
+        }
 
         MMRESULT res = waveOutWrite(audio_hWaveOut, &audio_waveHdrs[audio_current_buffer], sizeof(WAVEHDR));
         if (res != MMSYSERR_NOERROR)
@@ -82,6 +167,8 @@ static void audio_thread_func()
             Sleep(1);
 
         audio_waveHdrs[audio_current_buffer].dwFlags &= ~WHDR_DONE;
+        // The buffer just finished, so its last frame is being heard about now.
+        audio_clock.update(get_time());
 
         audio_current_buffer = (audio_current_buffer + 1) % AUDIO_BUFFERS;
     }
@@ -93,18 +180,41 @@ static void audio_thread_func()
     waveOutClose(audio_hWaveOut);
 }
 
-static bool audio_init(u32 sample_rate, i32 channels, i32 frame_count,
-    config_t::audio_callback_t cb, void* userdata)
+static bool audio_init(const config_t& config)
 {
     LOG_INFO("Initializing audio subsystem...");
-    ASSERT(cb != nullptr, "Audio callback cannot be null");
     if (audio_running) return false;
 
+    u32 sample_rate = config.audio_sample_rate;
+    i32 channels = config.audio_channels;
+    i32 frame_count = config.audio_frame_count;
+
     audio_sample_rate = sample_rate;
     audio_channels = channels;
     audio_frame_count = frame_count;
-    audio_callback = cb;
-    audio_userdata = userdata;
+    audio_callback = config.audio_callback;
+    audio_callback_f32 = config.audio_callback_f32;
+    audio_userdata = config.audio_userdata;
+    audio_dither_enabled = config.audio_dither;
+    audio_float_buffer.assign(frame_count * channels, 0.0f);
+    audio_command_callback = config.audio_command_callback;
+    audio_thread_policy = config.audio_thread_policy;
+    audio_thread_cpu = config.audio_thread_cpu;
+    audio_telemetry.reset(frame_count * 1000.0 / sample_rate, frame_count * AUDIO_BUFFERS);
+    audio_clock.reset(sample_rate);
+
+    // Without a user callback the built-in mixer renders the output.
+    audio_mixer_enabled = audio_callback == nullptr && audio_callback_f32 == nullptr;
+    if (audio_mixer_enabled)
+    {
+        if (!mixer_init(&audio_mixer, sample_rate, channels, frame_count, config.audio_voices, config.audio_buses))
+        {
+            audio_mixer_enabled = false;
+            return false;
+        }
+        audio_callback_f32 = mixer_audio_callback_f32;
+        audio_userdata = &audio_mixer;
+    }
 
     WAVEFORMATEX wfx{};
     wfx.wFormatTag = WAVE_FORMAT_PCM;
@@ -146,39 +256,195 @@ static void audio_shutdown()
     audio_running = false;
     if (audio_thread.joinable())
         audio_thread.join();
+
+    if (audio_mixer_enabled)
+    {
+        mixer_shutdown(&audio_mixer);
+        audio_mixer_enabled = false;
+    }
+}
+
+// Loader
+static f64 loader_upload_budget_ms = 0.0;
+
+// Timing
+static u64 device_start_ticks = 0;
+
+// Frame limiter
+// Sleep() rounds up to the timer period, 1 ms while the cap raises its resolution, so
+// the last FRAME_LIMITER_SPIN_NS before a deadline are spun instead.
+#define FRAME_LIMITER_SPIN_NS 2000000ull
+
+static frame_limiter_t frame_limiter;
+static bool frame_limiter_timer_period = false;
+
+static void frame_limiter_wait()
+{
+    PROFILE_SCOPE("frame_limiter_wait");
+    u64 now = get_time_ns();
+    u64 deadline = frame_limiter.next_deadline(now);
+    if (deadline == 0)
+        return;
+
+    if (deadline > now + frame_limiter.spin_ns)
+        Sleep(static_cast<DWORD>((deadline - frame_limiter.spin_ns - now) / 1000000ull));
+
+    u64 spin_start = get_time_ns();
+    while ((now = get_time_ns()) < deadline)
+        YieldProcessor();
+    frame_limiter.record(deadline, now, now - spin_start);
+}
+
+// Input
+// GLFW only reports levels, so changes between polls become events stamped with the poll time.
+static bool input_buttons[GP_BTN_COUNT] = { false };
+static f32 input_axes[GP_AXIS_COUNT] = { 0.0f };
+
+static i32 map_button(u8 btn)
+{
+    switch (btn)
+    {
+    case GP_BTN_A:      return GLFW_GAMEPAD_BUTTON_A;
+    case GP_BTN_B:      return GLFW_GAMEPAD_BUTTON_B;
+    case GP_BTN_X:      return GLFW_GAMEPAD_BUTTON_X;
+    case GP_BTN_Y:      return GLFW_GAMEPAD_BUTTON_Y;
+    case GP_BTN_L1:     return GLFW_GAMEPAD_BUTTON_LEFT_BUMPER;
+    case GP_BTN_L2:     return GLFW_GAMEPAD_BUTTON_LEFT_BUMPER;
+    case GP_BTN_L3:     return GLFW_GAMEPAD_BUTTON_LEFT_THUMB;
+    case GP_BTN_R1:     return GLFW_GAMEPAD_BUTTON_RIGHT_BUMPER;
+    case GP_BTN_R2:     return GLFW_GAMEPAD_BUTTON_RIGHT_BUMPER;
+    case GP_BTN_R3:     return GLFW_GAMEPAD_BUTTON_RIGHT_THUMB;
+    case GP_BTN_SELECT: return GLFW_GAMEPAD_BUTTON_BACK;
+    case GP_BTN_START:  return GLFW_GAMEPAD_BUTTON_START;
+    case GP_BTN_UP:     return GLFW_GAMEPAD_BUTTON_DPAD_UP;
+    case GP_BTN_DOWN:   return GLFW_GAMEPAD_BUTTON_DPAD_DOWN;
+    case GP_BTN_LEFT:   return GLFW_GAMEPAD_BUTTON_DPAD_LEFT;
+    case GP_BTN_RIGHT:  return GLFW_GAMEPAD_BUTTON_DPAD_RIGHT;
+    default: return -1;
+    }
+}
+
+static void input_poll()
+{
+    PROFILE_SCOPE("input_poll");
+    const f64 time = get_time();
+
+    GLFWgamepadstate state;
+    bool gamepad = glfwJoystickIsGamepad(GLFW_JOYSTICK_1) && glfwGetGamepadState(GLFW_JOYSTICK_1, &state);
+    for (u8 b = 0; b < GP_BTN_COUNT; ++b)
+    {
+        i32 g = map_button(b);
+        bool down = gamepad && g >= 0 && state.buttons[g];
+        if (down == input_buttons[b])
+            continue;
+        input_buttons[b] = down;
+        input_queue_push({ time, INPUT_EVENT_BUTTON, b, down ? 1.0f : 0.0f });
+    }
+
+    i32 count = 0;
+    const f32* axes = glfwJoystickPresent(GLFW_JOYSTICK_1) ? glfwGetJoystickAxes(GLFW_JOYSTICK_1, &count) : nullptr;
+    for (u8 a = 0; a < GP_AXIS_COUNT; ++a)
+    {
+        f32 value = axes && a < count ? axes[a] : 0.0f;
+        if (value == input_axes[a])
+            continue;
+        input_axes[a] = value;
+        input_queue_push({ time, INPUT_EVENT_AXIS, a, value });
+    }
 }
 
 // Public API
 bool init(const config_t& config)
 {
-    if (!display_init(config.display_width, config.display_height, config.display_title))
+    if (!display_init(config.display_width, config.display_height, config.display_title, config.display_upload_context))
         return false;
-
-    //if (!audio_init(config.audio_sample_rate, config.audio_channels, config.audio_frame_count,
-    //                config.audio_callback, config.audio_userdata))
+    device_start_ticks = glfwGetTimerValue();
+    PROFILE_THREAD("main");
+    perf_counters_init(config.perf_counters);
+    frame_limiter.reset(config.display_frame_cap, config.display_paused_cap, FRAME_LIMITER_SPIN_NS);
+    frame_limiter_timer_period = (config.display_frame_cap > 0.0 || config.display_paused_cap > 0.0) &&
+        timeBeginPeriod(1) == TIMERR_NOERROR;
+    frame_stats_init();
+
+    //if (!audio_init(config))
     //    return false;
 
+    if (config.loader_threads > 0 && !loader_init(config.loader_threads, display_upload_window != nullptr))
+        LOG_WARN("Asset loader initialization failed. Continuing without async loading.");
+    loader_upload_budget_ms = config.loader_upload_budget_ms;
+
+    input_queue_reset();
+    for (u8 b = 0; b < GP_BTN_COUNT; ++b)
+        input_buttons[b] = false;
+    for (u8 a = 0; a < GP_AXIS_COUNT; ++a)
+        input_axes[a] = 0.0f;
+
     LOG_INFO("Device initialized successfully.");
     return true;
 }
 
 void shutdown()
 {
+    input_record_stop();
+    input_replay_stop();
+    frame_stats_shutdown();
+    if (frame_limiter_timer_period)
+        timeEndPeriod(1);
+    frame_limiter_timer_period = false;
+    loader_shutdown();
     display_shutdown();
     //audio_shutdown();
+    perf_counters_shutdown();
 
     LOG_INFO("Device shutdown complete.");
 }
 
 bool begin_frame()
 {
+    frame_limiter_wait();
+    PROFILE_SCOPE("begin_frame");
+    frame_stats_begin(get_time_ns());
+    perf_counters_begin();
+    glfwPollEvents();
+    input_poll();
+    input_queue_update(get_time());
+    loader_update(loader_upload_budget_ms);
     return !glfwWindowShouldClose(display_window);
 }
 
 void end_frame()
 {
-    glfwPollEvents();
-    glfwSwapBuffers(display_window);
+    PROFILE_SCOPE("end_frame");
+    perf_counters_end();
+    frame_stats_present(get_time_ns());
+    {
+        PROFILE_SCOPE("display_present");
+        glfwSwapBuffers(display_window);
+    }
+    frame_stats_end(get_time_ns());
+    input_queue_presented(get_time());
+}
+
+void set_paused(bool paused)
+{
+    frame_limiter.set_paused(paused);
+}
+
+void get_frame_limiter_stats(frame_limiter_stats_t* stats)
+{
+    frame_limiter.get_stats(stats);
+}
+
+void get_perf_stats(perf_stats_t* stats)
+{
+    perf_counters_get(stats);
+}
+
+// GLFW only reads gamepads on the main thread, so config_t::input_thread does not apply.
+void input_latch()
+{
+    input_poll();
+    input_queue_latch(get_time());
 }
 
 void close()
@@ -191,51 +457,81 @@ void screen_size(i32* width, i32* height)
     glfwGetFramebufferSize(display_window, width, height);
 }
 
-f64 get_time()
+mixer_t* get_mixer()
 {
-    return glfwGetTime();
+    return audio_mixer_enabled ? &audio_mixer : nullptr;
 }
 
-bool is_button_pressed(u8 btn)
+bool audio_post(const audio_command_t& command)
 {
-    if (!glfwJoystickIsGamepad(GLFW_JOYSTICK_1))
-        return false;
+    return audio_commands.push(command);
+}
 
-    GLFWgamepadstate state;
-    if (!glfwGetGamepadState(GLFW_JOYSTICK_1, &state))
+void audio_get_stats(audio_stats_t* stats)
+{
+    audio_telemetry.snapshot(stats);
+}
+
+bool audio_get_info(audio_info_t* info)
+{
+    if (!audio_running)
         return false;
 
-    switch (btn)
-    {
-    case GP_BTN_A:      return state.buttons[GLFW_GAMEPAD_BUTTON_A];
-    case GP_BTN_B:      return state.buttons[GLFW_GAMEPAD_BUTTON_B];
-    case GP_BTN_X:      return state.buttons[GLFW_GAMEPAD_BUTTON_X];
-    case GP_BTN_Y:      return state.buttons[GLFW_GAMEPAD_BUTTON_Y];
-    case GP_BTN_L1:     return state.buttons[GLFW_GAMEPAD_BUTTON_LEFT_BUMPER];
-    case GP_BTN_L2:     return state.buttons[GLFW_GAMEPAD_BUTTON_LEFT_BUMPER];
-    case GP_BTN_L3:     return state.buttons[GLFW_GAMEPAD_BUTTON_LEFT_THUMB];
-    case GP_BTN_R1:     return state.buttons[GLFW_GAMEPAD_BUTTON_RIGHT_BUMPER];
-    case GP_BTN_R2:     return state.buttons[GLFW_GAMEPAD_BUTTON_RIGHT_BUMPER];
-    case GP_BTN_R3:     return state.buttons[GLFW_GAMEPAD_BUTTON_RIGHT_THUMB];
-    case GP_BTN_SELECT: return state.buttons[GLFW_GAMEPAD_BUTTON_BACK];
-    case GP_BTN_START:  return state.buttons[GLFW_GAMEPAD_BUTTON_START];
-    case GP_BTN_UP:     return state.buttons[GLFW_GAMEPAD_BUTTON_DPAD_UP];
-    case GP_BTN_DOWN:   return state.buttons[GLFW_GAMEPAD_BUTTON_DPAD_DOWN];
-    case GP_BTN_LEFT:   return state.buttons[GLFW_GAMEPAD_BUTTON_DPAD_LEFT];
-    case GP_BTN_RIGHT:  return state.buttons[GLFW_GAMEPAD_BUTTON_DPAD_RIGHT];
-    default: return false;
-    }
+    info->sample_rate = audio_sample_rate;
+    info->channels = audio_channels;
+    info->period_frames = audio_frame_count;
+    info->period_count = AUDIO_BUFFERS;
+    info->buffer_frames = audio_frame_count * AUDIO_BUFFERS;
+    info->mmap = false;
+    info->float_output = false;
+    info->resampling = false;
+    return true;
 }
 
-f32 get_axis_value(u8 axis)
+f64 audio_output_latency()
 {
-    if (!glfwJoystickPresent(GLFW_JOYSTICK_1))
-        return 0.f;
+    // waveOut queues every buffer but the one being filled.
+    if (!audio_running)
+        return 0.0;
+    return static_cast<f64>(audio_frame_count) * (AUDIO_BUFFERS - 1) / audio_sample_rate;
+}
 
-    i32 count = 0;
-    const f32* axes = glfwGetJoystickAxes(GLFW_JOYSTICK_1, &count);
-    if (!axes || axis >= count)
-        return 0.f;
+u64 audio_get_frame()
+{
+    return audio_clock.time_to_frame(get_time());
+}
+
+f64 audio_frame_to_time(u64 frame)
+{
+    return audio_clock.frame_to_time(frame);
+}
+
+u64 audio_time_to_frame(f64 time)
+{
+    return audio_clock.time_to_frame(time);
+}
 
-    return axes[axis];
+bool bind_upload_context()
+{
+    if (!display_upload_window)
+        return false;
+    glfwMakeContextCurrent(display_upload_window);
+    return true;
+}
+
+void unbind_upload_context()
+{
+    glfwMakeContextCurrent(nullptr);
+}
+
+u64 get_time_ns()
+{
+    u64 ticks = glfwGetTimerValue() - device_start_ticks;
+    u64 frequency = glfwGetTimerFrequency();
+    return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency;
+}
+
+f64 get_time()
+{
+    return static_cast<f64>(glfwGetTimerValue() - device_start_ticks) / glfwGetTimerFrequency();
 }
\ No newline at end of file
@@ -0,0 +1,516 @@
+#include <device.hpp>
+#include <input.hpp>
+#include <ring.hpp>
+#include <cctype>
+
+static spsc_ring_t<input_event_t, INPUT_EVENT_CAPACITY> input_queue;
+static std::atomic<u32> input_dropped(0);
+
+// Producer state, published under a sequence lock
+static u32 input_latest_buttons = 0;
+static f32 input_latest_axes[GP_AXIS_COUNT] = { 0.0f };
+static std::atomic<u32> input_level_sequence(0);
+static std::atomic<u32> input_level_buttons(0);
+static std::atomic<f32> input_level_axes[GP_AXIS_COUNT];
+
+// Game thread state
+static bool input_buttons[GP_BTN_COUNT] = { false };
+static bool input_pressed[GP_BTN_COUNT] = { false };
+static bool input_released[GP_BTN_COUNT] = { false };
+static f32 input_axes[GP_AXIS_COUNT] = { 0.0f };
+static input_event_t input_frame_events[INPUT_EVENT_CAPACITY];
+static u32 input_frame_count = 0;
+static u32 input_seen_dropped = 0;
+static input_stats_t input_stats;
+static f64 input_latency_total_ms = 0.0;
+
+// Events consumed since the last present, kept as sums so any count costs O(1).
+static u64 input_unpresented = 0;
+static f64 input_unpresented_time_sum = 0.0;
+static f64 input_unpresented_oldest = 0.0;
+static u64 input_presented = 0;
+static f64 input_photon_total_ms = 0.0;
+
+// Record / replay. A recording is a magic number followed by fixed size little endian
+// records: u32 frame, u8 type, u8 control, u16 age in microseconds, f32 value. Frames
+// count input_queue_update() calls since the recording started.
+#define INPUT_RECORD_MAGIC		0x31504E49		// "INP1"
+#define INPUT_RECORD_BYTES		12
+#define INPUT_RECORD_LATCHED	0x80			// Type flag, consumed by input_latch()
+#define INPUT_RECORD_END		0xFF			// Type of the last record, on the first frame not recorded
+
+struct input_record_t
+{
+    u32 frame;
+    u8 type;
+    u8 control;
+    u16 age_us;		// Event timestamp to the sample that consumed it
+    f32 value;
+};
+
+static FILE* input_record_file = nullptr;
+static FILE* input_replay_file = nullptr;
+static input_record_t input_replay_next;
+static bool input_replay_has_next = false;
+static u32 input_frame = 0;
+static u32 input_record_base = 0;		// input_frame when recording or replay started
+
+// Latched events waiting for the next frame sample to measure how early they were.
+static u64 input_latch_pending = 0;
+static f64 input_latch_time_sum = 0.0;
+static f64 input_latch_saved_total_ms = 0.0;
+
+static void publish_levels()
+{
+    u32 seq = input_level_sequence.load(std::memory_order_relaxed);
+    input_level_sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    input_level_buttons.store(input_latest_buttons, std::memory_order_relaxed);
+    for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+        input_level_axes[i].store(input_latest_axes[i], std::memory_order_relaxed);
+    input_level_sequence.store(seq + 2, std::memory_order_release);
+}
+
+static void read_levels(u32* buttons, f32* axes)
+{
+    u32 before, after;
+    do
+    {
+        before = input_level_sequence.load(std::memory_order_acquire);
+        *buttons = input_level_buttons.load(std::memory_order_relaxed);
+        for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+            axes[i] = input_level_axes[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = input_level_sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+static void apply_event(const input_event_t& event)
+{
+    if (event.type == INPUT_EVENT_BUTTON && event.control < GP_BTN_COUNT)
+    {
+        bool down = event.value != 0.0f;
+        if (down && !input_buttons[event.control])
+            input_pressed[event.control] = true;
+        else if (!down && input_buttons[event.control])
+            input_released[event.control] = true;
+        input_buttons[event.control] = down;
+    }
+    else if (event.type == INPUT_EVENT_AXIS && event.control < GP_AXIS_COUNT)
+    {
+        input_axes[event.control] = event.value;
+    }
+}
+
+static void record_latency(f64 ms)
+{
+    input_stats.events++;
+    input_latency_total_ms += ms;
+    input_stats.latency_avg_ms = input_latency_total_ms / input_stats.events;
+    if (ms > input_stats.latency_max_ms)
+        input_stats.latency_max_ms = ms;
+
+    u32 bucket = ms > 0.0 ? static_cast<u32>(ms / INPUT_HISTOGRAM_MS) : 0;
+    input_stats.latency_histogram[bucket < INPUT_HISTOGRAM_BUCKETS ? bucket : INPUT_HISTOGRAM_BUCKETS - 1]++;
+}
+
+static void write_u32(FILE* file, u32 v)
+{
+    u8 bytes[4] = { static_cast<u8>(v), static_cast<u8>(v >> 8), static_cast<u8>(v >> 16), static_cast<u8>(v >> 24) };
+    fwrite(bytes, 1, 4, file);
+}
+
+static u32 read_u32(const u8* bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<u32>(bytes[3]) << 24);
+}
+
+static void write_record(FILE* file, const input_record_t& record)
+{
+    u32 value;
+    memcpy(&value, &record.value, sizeof(value));
+    u8 bytes[INPUT_RECORD_BYTES] = {
+        static_cast<u8>(record.frame), static_cast<u8>(record.frame >> 8), static_cast<u8>(record.frame >> 16), static_cast<u8>(record.frame >> 24),
+        record.type, record.control, static_cast<u8>(record.age_us), static_cast<u8>(record.age_us >> 8),
+        static_cast<u8>(value), static_cast<u8>(value >> 8), static_cast<u8>(value >> 16), static_cast<u8>(value >> 24) };
+    fwrite(bytes, 1, INPUT_RECORD_BYTES, file);
+}
+
+static bool read_record(FILE* file, input_record_t* record)
+{
+    u8 bytes[INPUT_RECORD_BYTES];
+    if (fread(bytes, 1, INPUT_RECORD_BYTES, file) != INPUT_RECORD_BYTES)
+        return false;
+
+    u32 value = read_u32(bytes + 8);
+    record->frame = read_u32(bytes);
+    record->type = bytes[4];
+    record->control = bytes[5];
+    record->age_us = static_cast<u16>(bytes[6] | (bytes[7] << 8));
+    memcpy(&record->value, &value, sizeof(value));
+    return true;
+}
+
+// Applies one event to the frame, and appends it to the recording if there is one.
+static void consume(const input_event_t& event, f64 now, bool latched)
+{
+    apply_event(event);
+    record_latency((now - event.time) * 1000.0);
+    if (input_frame_count < INPUT_EVENT_CAPACITY)
+        input_frame_events[input_frame_count++] = event;
+
+    if (input_unpresented == 0 || event.time < input_unpresented_oldest)
+        input_unpresented_oldest = event.time;
+    input_unpresented++;
+    input_unpresented_time_sum += event.time;
+
+    if (input_record_file)
+    {
+        f64 age_us = (now - event.time) * 1e6;
+        input_record_t record;
+        record.frame = input_frame - input_record_base;
+        record.type = static_cast<u8>(event.type | (latched ? INPUT_RECORD_LATCHED : 0));
+        record.control = event.control;
+        record.age_us = static_cast<u16>(age_us < 0.0 ? 0.0 : age_us > 65535.0 ? 65535.0 : age_us);
+        record.value = event.value;
+        write_record(input_record_file, record);
+    }
+}
+
+// Feeds the recorded events that belong to this frame, or to this latch of it.
+static u32 drain_replay(f64 now, bool latched)
+{
+    u32 frame = input_frame - input_record_base;
+    u32 count = 0;
+    while (input_replay_has_next && input_replay_next.type != INPUT_RECORD_END &&
+        (input_replay_next.frame < frame || (input_replay_next.frame == frame && (latched || !(input_replay_next.type & INPUT_RECORD_LATCHED)))))
+    {
+        input_event_t event;
+        event.time = now - input_replay_next.age_us * 1e-6;
+        event.type = static_cast<u8>(input_replay_next.type & ~INPUT_RECORD_LATCHED);
+        event.control = input_replay_next.control;
+        event.value = input_replay_next.value;
+        consume(event, now, latched);
+        count++;
+        input_replay_has_next = read_record(input_replay_file, &input_replay_next);
+    }
+
+    if (!input_replay_has_next || (input_replay_next.type == INPUT_RECORD_END && input_replay_next.frame <= frame))
+    {
+        LOG_INFO("Input replay finished after %u frames", frame - 1);
+        input_replay_stop();
+    }
+    return count;
+}
+
+// Applies everything queued and returns how many events that was.
+static u32 drain(f64 now, bool latched)
+{
+    u32 count = 0;
+    input_event_t event;
+    if (input_replay_file)
+    {
+        // The device keeps producing while replaying; drop that so the queue never fills.
+        while (input_queue.pop(&event)) {}
+        input_seen_dropped = input_dropped.load(std::memory_order_relaxed);
+        input_stats.dropped = input_seen_dropped;
+        return drain_replay(now, latched);
+    }
+
+    while (input_frame_count < INPUT_EVENT_CAPACITY && input_queue.pop(&event))
+    {
+        consume(event, now, latched);
+        count++;
+    }
+
+    // Events were lost, so the queue no longer adds up to the device state. Catch up
+    // with the published levels through events, so recordings see the same changes.
+    u32 dropped = input_dropped.load(std::memory_order_relaxed);
+    if (dropped != input_seen_dropped && input_queue.size() == 0)
+    {
+        u32 buttons;
+        f32 axes[GP_AXIS_COUNT];
+        read_levels(&buttons, axes);
+        for (u32 i = 0; i < GP_BTN_COUNT; ++i)
+        {
+            bool down = (buttons >> i) & 1;
+            if (down != input_buttons[i])
+                consume({ now, INPUT_EVENT_BUTTON, static_cast<u8>(i), down ? 1.0f : 0.0f }, now, latched);
+        }
+        for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+        {
+            if (axes[i] != input_axes[i])
+                consume({ now, INPUT_EVENT_AXIS, static_cast<u8>(i), axes[i] }, now, latched);
+        }
+        input_seen_dropped = dropped;
+    }
+    input_stats.dropped = dropped;
+    return count;
+}
+
+void input_queue_reset()
+{
+    input_event_t event;
+    while (input_queue.pop(&event)) {}
+    input_dropped.store(0, std::memory_order_relaxed);
+
+    input_latest_buttons = 0;
+    for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+        input_latest_axes[i] = 0.0f;
+    publish_levels();
+
+    for (u32 i = 0; i < GP_BTN_COUNT; ++i)
+        input_buttons[i] = input_pressed[i] = input_released[i] = false;
+    for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+        input_axes[i] = 0.0f;
+    input_frame_count = 0;
+    input_seen_dropped = 0;
+    memset(&input_stats, 0, sizeof(input_stats));
+    input_latency_total_ms = 0.0;
+    input_unpresented = 0;
+    input_unpresented_time_sum = 0.0;
+    input_presented = 0;
+    input_photon_total_ms = 0.0;
+    input_latch_pending = 0;
+    input_latch_time_sum = 0.0;
+    input_latch_saved_total_ms = 0.0;
+}
+
+bool input_queue_push(const input_event_t& event)
+{
+    if (event.type == INPUT_EVENT_BUTTON && event.control < GP_BTN_COUNT)
+    {
+        u32 bit = 1u << event.control;
+        input_latest_buttons = event.value != 0.0f ? input_latest_buttons | bit : input_latest_buttons & ~bit;
+    }
+    else if (event.type == INPUT_EVENT_AXIS && event.control < GP_AXIS_COUNT)
+    {
+        input_latest_axes[event.control] = event.value;
+    }
+    publish_levels();
+
+    if (input_queue.push(event))
+        return true;
+    input_queue_dropped(1);
+    return false;
+}
+
+void input_queue_dropped(u32 count)
+{
+    input_dropped.store(input_dropped.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+void input_queue_update(f64 now)
+{
+    for (u32 i = 0; i < GP_BTN_COUNT; ++i)
+        input_pressed[i] = input_released[i] = false;
+    input_frame_count = 0;
+    input_frame++;
+
+    // Latched events of the previous frame would have been seen only now.
+    if (input_latch_pending > 0)
+    {
+        input_latch_saved_total_ms += (now * input_latch_pending - input_latch_time_sum) * 1000.0;
+        input_stats.latched += input_latch_pending;
+        input_stats.latch_saved_avg_ms = input_latch_saved_total_ms / input_stats.latched;
+        input_latch_pending = 0;
+        input_latch_time_sum = 0.0;
+    }
+
+    drain(now, false);
+}
+
+void input_queue_latch(f64 now)
+{
+    u32 count = drain(now, true);
+    input_latch_pending += count;
+    input_latch_time_sum += now * count;
+}
+
+void input_queue_presented(f64 time)
+{
+    if (input_unpresented == 0)
+        return;
+
+    input_photon_total_ms += (time * input_unpresented - input_unpresented_time_sum) * 1000.0;
+    input_presented += input_unpresented;
+    input_stats.photon_avg_ms = input_photon_total_ms / input_presented;
+    f64 oldest_ms = (time - input_unpresented_oldest) * 1000.0;
+    if (oldest_ms > input_stats.photon_max_ms)
+        input_stats.photon_max_ms = oldest_ms;
+
+    input_unpresented = 0;
+    input_unpresented_time_sum = 0.0;
+}
+
+bool input_record_start(const char* path)
+{
+    input_record_stop();
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        LOG_ERROR("Failed to create input recording %s", path);
+        return false;
+    }
+
+    write_u32(file, INPUT_RECORD_MAGIC);
+    input_record_file = file;
+    input_record_base = input_frame;
+
+    // Start from the current levels, so a replay does not depend on what was held before.
+    for (u32 i = 0; i < GP_BTN_COUNT; ++i)
+    {
+        if (input_buttons[i])
+            write_record(file, { 0, INPUT_EVENT_BUTTON, static_cast<u8>(i), 0, 1.0f });
+    }
+    for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+    {
+        if (input_axes[i] != 0.0f)
+            write_record(file, { 0, INPUT_EVENT_AXIS, static_cast<u8>(i), 0, input_axes[i] });
+    }
+
+    LOG_INFO("Recording input to %s", path);
+    return true;
+}
+
+void input_record_stop()
+{
+    if (!input_record_file)
+        return;
+
+    write_record(input_record_file, { input_frame + 1 - input_record_base, INPUT_RECORD_END, 0, 0, 0.0f });
+    if (fclose(input_record_file) != 0)
+        LOG_ERROR("Failed to finish input recording");
+    input_record_file = nullptr;
+}
+
+bool input_replay_start(const char* path)
+{
+    input_replay_stop();
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        LOG_ERROR("Failed to open input recording %s", path);
+        return false;
+    }
+
+    u8 magic[4];
+    if (fread(magic, 1, 4, file) != 4 || read_u32(magic) != INPUT_RECORD_MAGIC)
+    {
+        LOG_ERROR("%s is not an input recording", path);
+        fclose(file);
+        return false;
+    }
+
+    input_replay_file = file;
+    input_record_base = input_frame;
+
+    // Take over the recording's starting levels without producing edges.
+    for (u32 i = 0; i < GP_BTN_COUNT; ++i)
+        input_buttons[i] = false;
+    for (u32 i = 0; i < GP_AXIS_COUNT; ++i)
+        input_axes[i] = 0.0f;
+    input_replay_has_next = read_record(file, &input_replay_next);
+    while (input_replay_has_next && input_replay_next.frame == 0 && input_replay_next.type < INPUT_RECORD_LATCHED)
+    {
+        if (input_replay_next.type == INPUT_EVENT_BUTTON && input_replay_next.control < GP_BTN_COUNT)
+            input_buttons[input_replay_next.control] = input_replay_next.value != 0.0f;
+        else if (input_replay_next.type == INPUT_EVENT_AXIS && input_replay_next.control < GP_AXIS_COUNT)
+            input_axes[input_replay_next.control] = input_replay_next.value;
+        input_replay_has_next = read_record(file, &input_replay_next);
+    }
+
+    LOG_INFO("Replaying input from %s", path);
+    return true;
+}
+
+void input_replay_stop()
+{
+    if (input_replay_file)
+        fclose(input_replay_file);
+    input_replay_file = nullptr;
+    input_replay_has_next = false;
+}
+
+bool input_replaying()
+{
+    return input_replay_file != nullptr;
+}
+
+static u32 count_bits(u32 bits)
+{
+    u32 count = 0;
+    for (; bits; bits &= bits - 1)
+        count++;
+    return count;
+}
+
+static bool name_contains(const char* name, const char* word)
+{
+    for (; *name; ++name)
+    {
+        u32 i = 0;
+        while (word[i] && tolower(static_cast<u8>(name[i])) == word[i])
+            i++;
+        if (!word[i])
+            return true;
+    }
+    return false;
+}
+
+i32 input_score_device(const input_device_desc_t& desc)
+{
+    if (desc.accelerometer)
+        return -1;
+
+    // Keyboards map a few of the buttons too, and give themselves away with letters.
+    u32 buttons = count_bits(desc.buttons);
+    if (!desc.gamepad && (buttons < 4 || desc.keys >= 20))
+        return -1;
+
+    i32 score = static_cast<i32>(buttons * 2 + count_bits(desc.axes) * 3);
+    if (desc.gamepad)
+        score += 8;
+
+    static const char* hints[] = { "gamepad", "joypad", "joystick", "controller" };
+    for (const char* hint : hints)
+    {
+        if (desc.name && name_contains(desc.name, hint))
+        {
+            score += 4;
+            break;
+        }
+    }
+    return score;
+}
+
+bool is_button_pressed(u8 btn)
+{
+    return btn < GP_BTN_COUNT && input_buttons[btn];
+}
+
+bool was_button_pressed(u8 btn)
+{
+    return btn < GP_BTN_COUNT && input_pressed[btn];
+}
+
+bool was_button_released(u8 btn)
+{
+    return btn < GP_BTN_COUNT && input_released[btn];
+}
+
+f32 get_axis_value(u8 axis)
+{
+    return axis < GP_AXIS_COUNT ? input_axes[axis] : 0.0f;
+}
+
+const input_event_t* get_input_events(u32* count)
+{
+    *count = input_frame_count;
+    return input_frame_events;
+}
+
+void input_get_stats(input_stats_t* stats)
+{
+    *stats = input_stats;
+}
@@ -0,0 +1,356 @@
+#include <device.hpp>
+#include <loader.hpp>
+
+#include <string>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define LOADER_SHUTDOWN_FENCE_TIMEOUT_NS 1000000000ull
+
+struct load_job_t
+{
+    load_request_t request;
+    std::string path;
+    u64 sequence{ 0 };
+    std::atomic<u8> status{ LOAD_PENDING };
+    std::atomic<bool> cancelled{ false };
+    std::vector<u8> data;
+    GLsync fence{ nullptr };
+};
+
+// Highest priority first, FIFO within a priority.
+struct load_job_order_t
+{
+    bool operator()(const load_handle_t& a, const load_handle_t& b) const
+    {
+        if (a->request.priority != b->request.priority)
+            return a->request.priority < b->request.priority;
+        return a->sequence > b->sequence;
+    }
+};
+
+typedef std::priority_queue<load_handle_t, std::vector<load_handle_t>, load_job_order_t> load_queue_t;
+
+static std::vector<std::thread> loader_threads;
+static std::mutex loader_decode_mutex;
+static std::condition_variable loader_decode_cv;
+static load_queue_t loader_decode_queue;
+static std::mutex loader_upload_mutex;
+static std::condition_variable loader_upload_cv;
+static load_queue_t loader_upload_queue;
+static std::thread loader_upload_thread;
+static std::mutex loader_fence_mutex;
+static std::vector<load_handle_t> loader_fenced_jobs;
+static std::vector<load_handle_t> loader_ready_jobs;
+static std::atomic<bool> loader_background_uploads(false);
+static u64 loader_sequence = 0;
+static bool loader_running = false;
+
+static bool read_file(const char* path, std::vector<u8>& data)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    bool ok = size >= 0;
+    if (ok)
+    {
+        data.resize(static_cast<size_t>(size));
+        ok = fread(data.data(), 1, data.size(), file) == data.size();
+    }
+
+    fclose(file);
+    return ok;
+}
+
+static void loader_thread_func()
+{
+    for (;;)
+    {
+        load_handle_t job;
+        {
+            std::unique_lock<std::mutex> lock(loader_decode_mutex);
+            loader_decode_cv.wait(lock, [] { return !loader_running || !loader_decode_queue.empty(); });
+            if (!loader_running)
+                return;
+
+            job = loader_decode_queue.top();
+            loader_decode_queue.pop();
+        }
+
+        // Cancelled and failed jobs still go through the upload queue so that
+        // completion callbacks are always delivered on the GL thread.
+        if (!job->cancelled)
+        {
+            job->status = LOAD_DECODING;
+
+            bool ok = true;
+            if (!job->path.empty() && !read_file(job->path.c_str(), job->data))
+            {
+                LOG_ERROR("Failed to read asset: %s", job->path.c_str());
+                ok = false;
+            }
+
+            if (ok && job->request.decode && !job->cancelled)
+                ok = job->request.decode(job->data, job->request.userdata);
+
+            job->status = ok ? LOAD_UPLOADING : LOAD_FAILED;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(loader_upload_mutex);
+            loader_upload_queue.push(job);
+        }
+        loader_upload_cv.notify_one();
+    }
+}
+
+static GLsync upload_fence()
+{
+    // Without fence syncs (GLES 2.0) the upload thread waits for completion itself.
+    if (!glFenceSync)
+    {
+        glFinish();
+        return nullptr;
+    }
+
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    return fence;
+}
+
+static bool upload_fence_signaled(GLsync fence)
+{
+    if (!fence)
+        return true;
+    if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        return false;
+
+    glDeleteSync(fence);
+    return true;
+}
+
+static void loader_upload_thread_func()
+{
+    if (!bind_upload_context())
+    {
+        LOG_WARN("Failed to bind shared upload context. Uploads will run on the GL thread.");
+        loader_background_uploads = false;
+        return;
+    }
+
+    for (;;)
+    {
+        load_handle_t job;
+        {
+            std::unique_lock<std::mutex> lock(loader_upload_mutex);
+            loader_upload_cv.wait(lock, [] { return !loader_running || !loader_upload_queue.empty(); });
+            if (!loader_running)
+                break;
+
+            job = loader_upload_queue.top();
+            loader_upload_queue.pop();
+        }
+
+        // Successful uploads stay LOAD_UPLOADING until loader_update() sees their fence signal.
+        if (job->cancelled)
+            job->status = LOAD_CANCELLED;
+        else if (job->status == LOAD_UPLOADING)
+        {
+            if (!job->request.upload || job->request.upload(job->data, job->request.userdata))
+                job->fence = upload_fence();
+            else
+                job->status = LOAD_FAILED;
+        }
+
+        std::lock_guard<std::mutex> lock(loader_fence_mutex);
+        loader_fenced_jobs.push_back(job);
+    }
+
+    unbind_upload_context();
+}
+
+static void finish_job(const load_handle_t& job)
+{
+    std::vector<u8>().swap(job->data);
+    if (job->request.complete)
+        job->request.complete(job->status, job->request.userdata);
+}
+
+// Jobs the loader stops before they finish still resolve, so no handle stays pending.
+static void abandon_job(const load_handle_t& job)
+{
+    job->status = job->cancelled ? LOAD_CANCELLED : LOAD_FAILED;
+    finish_job(job);
+}
+
+bool loader_init(i32 thread_count, bool background_uploads)
+{
+    if (loader_running) return false;
+    if (thread_count <= 0)
+    {
+        LOG_ERROR("Loader requires at least one worker thread");
+        return false;
+    }
+
+    LOG_INFO("Starting asset loader with %d worker threads...", thread_count);
+    loader_running = true;
+    for (i32 i = 0; i < thread_count; ++i)
+        loader_threads.push_back(std::thread(loader_thread_func));
+
+    loader_background_uploads = background_uploads;
+    if (background_uploads)
+        loader_upload_thread = std::thread(loader_upload_thread_func);
+
+    return true;
+}
+
+void loader_shutdown()
+{
+    if (!loader_running) return;
+
+    {
+        std::lock_guard<std::mutex> decode_lock(loader_decode_mutex);
+        std::lock_guard<std::mutex> upload_lock(loader_upload_mutex);
+        loader_running = false;
+    }
+    loader_decode_cv.notify_all();
+    loader_upload_cv.notify_all();
+
+    for (auto& thread : loader_threads)
+        thread.join();
+    loader_threads.clear();
+    if (loader_upload_thread.joinable())
+        loader_upload_thread.join();
+
+    // Background uploads that already ran only need their fence.
+    for (auto& job : loader_fenced_jobs)
+    {
+        if (job->fence)
+        {
+            glClientWaitSync(job->fence, GL_SYNC_FLUSH_COMMANDS_BIT, LOADER_SHUTDOWN_FENCE_TIMEOUT_NS);
+            glDeleteSync(job->fence);
+            job->fence = nullptr;
+        }
+        if (job->status == LOAD_UPLOADING)
+            job->status = LOAD_DONE;
+        finish_job(job);
+    }
+    loader_fenced_jobs.clear();
+    loader_background_uploads = false;
+
+    for (; !loader_upload_queue.empty(); loader_upload_queue.pop())
+        abandon_job(loader_upload_queue.top());
+    for (; !loader_decode_queue.empty(); loader_decode_queue.pop())
+        abandon_job(loader_decode_queue.top());
+}
+
+void loader_update(f64 budget_ms)
+{
+    if (loader_background_uploads)
+    {
+        {
+            std::lock_guard<std::mutex> lock(loader_fence_mutex);
+            for (size_t i = 0; i < loader_fenced_jobs.size();)
+            {
+                if (!upload_fence_signaled(loader_fenced_jobs[i]->fence))
+                {
+                    ++i;
+                    continue;
+                }
+                loader_ready_jobs.push_back(loader_fenced_jobs[i]);
+                loader_fenced_jobs[i] = loader_fenced_jobs.back();
+                loader_fenced_jobs.pop_back();
+            }
+        }
+
+        for (auto& job : loader_ready_jobs)
+        {
+            job->fence = nullptr;
+            if (job->status == LOAD_UPLOADING)
+                job->status = LOAD_DONE;
+            finish_job(job);
+        }
+        loader_ready_jobs.clear();
+        return;
+    }
+
+    f64 deadline = get_time() + budget_ms * 1e-3;
+
+    for (;;)
+    {
+        load_handle_t job;
+        {
+            std::lock_guard<std::mutex> lock(loader_upload_mutex);
+            if (loader_upload_queue.empty())
+                return;
+
+            job = loader_upload_queue.top();
+            loader_upload_queue.pop();
+        }
+
+        if (job->cancelled)
+            job->status = LOAD_CANCELLED;
+        else if (job->status == LOAD_UPLOADING)
+        {
+            bool ok = !job->request.upload || job->request.upload(job->data, job->request.userdata);
+            job->status = ok ? LOAD_DONE : LOAD_FAILED;
+        }
+
+        finish_job(job);
+
+        if (get_time() >= deadline)
+            return;
+    }
+}
+
+load_handle_t load_async(const load_request_t& request)
+{
+    load_handle_t job(new load_job_t());
+    job->request = request;
+    if (request.path)
+        job->path = request.path;
+
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(loader_decode_mutex);
+        if (loader_running)
+        {
+            job->sequence = loader_sequence++;
+            loader_decode_queue.push(job);
+            queued = true;
+        }
+    }
+
+    if (!queued)
+    {
+        LOG_ERROR("Loader is not running, failing load of %s", request.path ? request.path : "generated asset");
+        abandon_job(job);
+        return job;
+    }
+    loader_decode_cv.notify_one();
+
+    return job;
+}
+
+u8 load_status(const load_handle_t& handle)
+{
+    return handle->status;
+}
+
+bool load_cancel(const load_handle_t& handle)
+{
+    u8 status = handle->status;
+    if (status == LOAD_DONE || status == LOAD_FAILED || status == LOAD_CANCELLED)
+        return false;
+
+    handle->cancelled = true;
+    return true;
+}
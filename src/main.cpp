@@ -1,42 +1,8 @@
 #include <device.hpp>
-
-#define PI 3.14159265
-
-struct chord_synth_t
-{
-    f32 phase[4];
-    f32 freq[4];
-    f32 sample_rate;
-    f32 lfo_phase[4];
-};
-
-static void audio_callback(i16* samples, i32 frames, void* userdata)
-{
-    chord_synth_t* s = (chord_synth_t*)userdata;
-
-    const f32 lfo_speeds[4] = { 0.03f, 0.025f, 0.035f, 0.02f };
-    const f32 lfo_amount = 0.2f;
-
-    for (i32 i = 0; i < frames; i++)
-    {
-        f32 value = 0.0f;
-        for (i32 n = 0; n < 3; n++)
-        {
-            f32 phase_offset = sinf(s->lfo_phase[n]) * lfo_amount;
-            value += sinf(s->phase[n] + phase_offset);
-
-            s->phase[n] += 2.0f * PI * s->freq[n] / s->sample_rate;
-            if (s->phase[n] > 2.0f * PI)
-                s->phase[n] -= 2.0f * PI;
-        }
-
-        value *= 0.25f;
-
-        i16 sample = (i16)(value * 3000);
-        samples[i * 2 + 0] = sample; // L
-        samples[i * 2 + 1] = sample; // R
-    }
-}
+#include <audio_offline.hpp>
+#include <profiler.hpp>
+#include <synth.hpp>
+#include <timestep.hpp>
 
 void APIENTRY gl_debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
@@ -63,15 +29,88 @@ static const char* fragment_shader_src =
 "  gl_FragColor = vColor;\n"
 "}";
 
+// Simulated at a fixed rate; rendering blends the last two states.
+struct demo_t
+{
+    vec2 pos{ 0.f, 0.f };
+    vec2 prev_pos{ 0.f, 0.f };
+    f32 time{ 0.f };
+    f32 prev_time{ 0.f };
+
+    GLuint program;
+    GLuint vao;
+    GLint utime_loc;
+    GLint upos_loc;
+};
+
+static void demo_tick(f64 dt, u64, void* userdata)
+{
+    PROFILE_SCOPE("demo_tick");
+    demo_t* demo = static_cast<demo_t*>(userdata);
+    f32 lx = get_axis_value(GP_AXIS_LX);
+    f32 ly = get_axis_value(GP_AXIS_LY);
+    f32 elapsed = static_cast<f32>(dt);
+
+    demo->prev_pos = demo->pos;
+    demo->prev_time = demo->time;
+    vec2 input{ lx * sqrt(1.0f - 0.5f * ly * ly), -ly * sqrt(1.0f - 0.5f * lx * lx) };
+    demo->pos = clamp(demo->pos + input * elapsed, -1.f, 1.f);
+    demo->time += elapsed;
+}
+
+static void demo_render(f32 alpha, void* userdata)
+{
+    PROFILE_SCOPE("demo_render");
+    demo_t* demo = static_cast<demo_t*>(userdata);
+    vec2 pos = demo->prev_pos + (demo->pos - demo->prev_pos) * alpha;
+    f32 time = demo->prev_time + (demo->time - demo->prev_time) * alpha;
+
+    i32 w, h;
+    screen_size(&w, &h);
+    glViewport(0, 0, w, h);
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    glUseProgram(demo->program);
+    glUniform1f(demo->utime_loc, time);
+    glUniform2f(demo->upos_loc, pos.x, pos.y);
+    glBindVertexArrayX(demo->vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArrayX(0);
+}
+
+static void log_perf_sample(const char* thread, const perf_sample_t& sample)
+{
+    if (!(sample.mask & (1u << PERF_COUNTER_CYCLES)))
+        return;
+
+    const u64* v = sample.values;
+    f64 ipc = v[PERF_COUNTER_CYCLES] > 0 ? static_cast<f64>(v[PERF_COUNTER_INSTRUCTIONS]) / v[PERF_COUNTER_CYCLES] : 0.0;
+    LOG_INFO("%s: %llu cycles, IPC %.2f, L1D misses %llu, LLC misses %llu, branch misses %llu%s", thread,
+        static_cast<unsigned long long>(v[PERF_COUNTER_CYCLES]), ipc,
+        static_cast<unsigned long long>(v[PERF_COUNTER_L1D_MISSES]), static_cast<unsigned long long>(v[PERF_COUNTER_LLC_MISSES]),
+        static_cast<unsigned long long>(v[PERF_COUNTER_BRANCH_MISSES]), sample.multiplexed ? " (estimated)" : "");
+}
+
 int main(int argc, char** args)
 {
-    chord_synth_t synth
+    // C4-E4-G4 pad with a slow vibrato; constant power pan puts 0.023 on each channel.
+    synth_t synth;
+    if (!synth_init(&synth, 44100, 2, 8))
+        return -1;
+    synth_patch_t patch;
+    patch.wave = SYNTH_WAVE_SINE;
+    patch.gain = 0.0325f;
+    patch.envelope.attack = 0.5f;
+    patch.envelope.sustain = 1.0f;
+    patch.lfo_rate = 0.2f;
+    patch.lfo_pitch = 0.05f;
+    const f32 chord[3] = { 261.63f, 329.63f, 392.00f };
+    for (i32 n = 0; n < 3; n++)
     {
-        {0,0,0,0},
-        { 261.63f, 329.63f, 392.00f, 523.25f }, // C4-E4-G4-C5
-        44100,
-        { 0.05f,0.1f,0.001f,0.5f }
-    };
+        patch.lfo_phase = n / 3.0f;
+        synth_note_on(&synth, patch, chord[n], 1.0f);
+    }
 
     config_t config{};
     config.display_title = "Game";
@@ -81,12 +120,32 @@ int main(int argc, char** args)
     config.audio_sample_rate = 44100;
     config.audio_channels = 2;
     config.audio_frame_count = 256;
-    config.audio_callback = audio_callback;
+    config.audio_callback_f32 = synth_audio_callback_f32;
     config.audio_userdata = &synth;
+    config.input_thread = true;
+    config.perf_counters = true;
+
+    // game --render-audio out.wav [seconds] [clock_rate] renders the synth without a device.
+    if (argc > 2 && strcmp(args[1], "--render-audio") == 0)
+    {
+        f64 seconds = argc > 3 ? atof(args[3]) : 10.0;
+        f64 clock_rate = argc > 4 ? atof(args[4]) : 0.0;
+        audio_offline_result_t result;
+        if (!audio_render_offline(config, args[2], seconds, clock_rate, &result))
+            return -1;
+        LOG_INFO("Callback max %.3f ms of a %.3f ms budget", result.stats.callback_max_ms, result.stats.period_budget_ms);
+        return 0;
+    }
 
 	if (!init(config))
 		return -1;
 
+    // game --record-input out.inp / --replay-input out.inp repeats a play session.
+    bool record = argc > 2 && strcmp(args[1], "--record-input") == 0 && input_record_start(args[2]);
+    bool replay = argc > 2 && strcmp(args[1], "--replay-input") == 0 && input_replay_start(args[2]);
+    // game --profile out.json writes a trace on R3 and at exit (needs -DGAME_PROFILE=ON).
+    const char* profile_path = argc > 2 && strcmp(args[1], "--profile") == 0 ? args[2] : nullptr;
+
     LOG_INFO("GL Vendor: %s", glGetString(GL_VENDOR));
     LOG_INFO("GL Renderer: %s", glGetString(GL_RENDERER));
     LOG_INFO("GL Version: %s", glGetString(GL_VERSION));
@@ -123,51 +182,93 @@ int main(int argc, char** args)
     glVertexAttribPointer(acolor_loc, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vertex_t), (void*)(2 * sizeof(GLfloat)));
     glBindVertexArrayX(0);
 
-    f32 time = 0.f;
-    f32 fps_timer = 0.f;
-    i32 fps_frames = 0;
-
-    vec2 pos{ 0.f, 0.f };
-
-    f64 last_time = get_time();
+    demo_t demo;
+    demo.program = program;
+    demo.vao = vao;
+    demo.utime_loc = utime_loc;
+    demo.upos_loc = upos_loc;
+
+    // Recorded and replayed sessions step once per frame so a replay repeats exactly.
+    timestep_t timestep;
+    timestep_init(&timestep, 60.0, 4);
+    timestep.lockstep = record || replay;
+
+    bool paused = false;
+    u64 stats_ns = 0;
+    u64 audio_xruns = 0;
+    u64 last_ns = get_time_ns();
 	while (begin_frame())
 	{
         if (is_button_pressed(GP_BTN_START)) close();
+        if (replay && !input_replaying()) close();
 
-        f64 curr_time = get_time();
-        f32 elapsed = (f32)(curr_time - last_time);
-        last_time = curr_time;
-
-        time += elapsed;
-        fps_timer += elapsed;
-        fps_frames++;
+        u64 curr_ns = get_time_ns();
+        stats_ns += curr_ns - last_ns;
+        last_ns = curr_ns;
 
-        if (fps_timer >= 1.f)
+        if (stats_ns >= 1000000000ull)
         {
-            f32 fps = fps_frames / fps_timer;
-            f32 frame_time = fps_timer / fps_frames;
-            LOG_INFO("%.2f fps, %.4f s/frame", fps, frame_time);
-            fps_timer = fmod(fps_timer, 1.f);
-            fps_frames = 0;
+            frame_stats_t frame_stats;
+            get_frame_stats(&frame_stats);
+            LOG_INFO("Frame ms p50 %.2f, p95 %.2f, p99 %.2f, worst %.2f (cpu %.2f, present %.2f, gpu %.2f)",
+                frame_stats.frame.p50_ms, frame_stats.frame.p95_ms, frame_stats.frame.p99_ms, frame_stats.frame.max_ms,
+                frame_stats.worst.cpu_ns * 1e-6, frame_stats.worst.present_ns * 1e-6, frame_stats.worst.gpu_ns * 1e-6);
+            LOG_INFO("CPU ms p50 %.2f, p99 %.2f; GPU ms p50 %.2f, p99 %.2f", frame_stats.cpu.p50_ms, frame_stats.cpu.p99_ms,
+                frame_stats.gpu.p50_ms, frame_stats.gpu.p99_ms);
+
+            audio_stats_t audio_stats;
+            audio_get_stats(&audio_stats);
+            if (audio_stats.xruns != audio_xruns)
+                LOG_WARN("Audio xruns: %llu (worst callback %.3f ms of %.3f ms budget)",
+                    static_cast<unsigned long long>(audio_stats.xruns), audio_stats.callback_max_ms, audio_stats.period_budget_ms);
+            audio_xruns = audio_stats.xruns;
+
+            input_stats_t input_stats;
+            input_get_stats(&input_stats);
+            if (input_stats.events > 0)
+                LOG_INFO("Input latency avg %.2f ms, max %.2f ms over %llu events", input_stats.latency_avg_ms,
+                    input_stats.latency_max_ms, static_cast<unsigned long long>(input_stats.events));
+            if (input_stats.photon_avg_ms > 0.0)
+                LOG_INFO("Input to photon avg %.2f ms, max %.2f ms, latching saved %.2f ms on %llu events", input_stats.photon_avg_ms,
+                    input_stats.photon_max_ms, input_stats.latch_saved_avg_ms, static_cast<unsigned long long>(input_stats.latched));
+            perf_stats_t perf_stats;
+            get_perf_stats(&perf_stats);
+            log_perf_sample("Game thread frame", perf_stats.main);
+            log_perf_sample("Audio thread between frames", perf_stats.audio);
+
+            frame_limiter_stats_t limiter_stats;
+            get_frame_limiter_stats(&limiter_stats);
+            if (limiter_stats.frames > 0)
+                LOG_INFO("Frame cap %.2f ms, wakeup jitter avg %.1f us, max %.1f us, spin avg %.1f us, %llu missed",
+                    limiter_stats.interval_ms, limiter_stats.jitter_avg_us, limiter_stats.jitter_max_us,
+                    limiter_stats.spin_avg_us, static_cast<unsigned long long>(limiter_stats.missed));
+            if (timestep.dropped_ns > 0)
+                LOG_WARN("Simulation fell %.1f ms behind", timestep.dropped_ns * 1e-6);
+            timestep.dropped_ns = 0;
+            stats_ns %= 1000000000ull;
         }
 
-        if (is_button_pressed(GP_BTN_A))      LOG_INFO("A pressed");
-        if (is_button_pressed(GP_BTN_B))      LOG_INFO("B pressed");
-        if (is_button_pressed(GP_BTN_X))      LOG_INFO("X pressed");
-        if (is_button_pressed(GP_BTN_Y))      LOG_INFO("Y pressed");
-        if (is_button_pressed(GP_BTN_L1))     LOG_INFO("L1 pressed");
-        if (is_button_pressed(GP_BTN_L2))     LOG_INFO("L2 pressed");
-        if (is_button_pressed(GP_BTN_L3))     LOG_INFO("L3 pressed");
-        if (is_button_pressed(GP_BTN_R1))     LOG_INFO("R1 pressed");
-        if (is_button_pressed(GP_BTN_R2))     LOG_INFO("R2 pressed");
-        if (is_button_pressed(GP_BTN_R3))     LOG_INFO("R3 pressed");
-        if (is_button_pressed(GP_BTN_START))  LOG_INFO("START pressed");
-        if (is_button_pressed(GP_BTN_SELECT)) LOG_INFO("SELECT pressed");
-        if (is_button_pressed(GP_BTN_UP))     LOG_INFO("UP pressed");
-        if (is_button_pressed(GP_BTN_DOWN))   LOG_INFO("DOWN pressed");
-        if (is_button_pressed(GP_BTN_LEFT))   LOG_INFO("LEFT pressed");
-        if (is_button_pressed(GP_BTN_RIGHT))  LOG_INFO("RIGHT pressed");
-
+        if (profile_path && was_button_pressed(GP_BTN_R3)) profile_dump(profile_path);
+
+        if (was_button_pressed(GP_BTN_A))      LOG_INFO("A pressed");
+        if (was_button_pressed(GP_BTN_B))      LOG_INFO("B pressed");
+        if (was_button_pressed(GP_BTN_X))      LOG_INFO("X pressed");
+        if (was_button_pressed(GP_BTN_Y))      LOG_INFO("Y pressed");
+        if (was_button_pressed(GP_BTN_L1))     LOG_INFO("L1 pressed");
+        if (was_button_pressed(GP_BTN_L2))     LOG_INFO("L2 pressed");
+        if (was_button_pressed(GP_BTN_L3))     LOG_INFO("L3 pressed");
+        if (was_button_pressed(GP_BTN_R1))     LOG_INFO("R1 pressed");
+        if (was_button_pressed(GP_BTN_R2))     LOG_INFO("R2 pressed");
+        if (was_button_pressed(GP_BTN_R3))     LOG_INFO("R3 pressed");
+        if (was_button_pressed(GP_BTN_START))  LOG_INFO("START pressed");
+        if (was_button_pressed(GP_BTN_SELECT)) LOG_INFO("SELECT pressed");
+        if (was_button_pressed(GP_BTN_UP))     LOG_INFO("UP pressed");
+        if (was_button_pressed(GP_BTN_DOWN))   LOG_INFO("DOWN pressed");
+        if (was_button_pressed(GP_BTN_LEFT))   LOG_INFO("LEFT pressed");
+        if (was_button_pressed(GP_BTN_RIGHT))  LOG_INFO("RIGHT pressed");
+
+        // Movement is the latency sensitive part, so pick up the newest stick values for it.
+        input_latch();
         f32 lx = get_axis_value(GP_AXIS_LX);
         f32 ly = get_axis_value(GP_AXIS_LY);
         f32 rx = get_axis_value(GP_AXIS_RX);
@@ -182,29 +283,30 @@ int main(int argc, char** args)
         if (is_button_pressed(GP_BTN_START))
             close();
 
-        vec2 input{ lx * sqrt(1.0f - 0.5f * ly * ly), -ly * sqrt(1.0f - 0.5f * lx * lx) };
-        pos = clamp(pos + input * elapsed, -1.f, 1.f);
-
-        i32 w, h;
-        screen_size(&w, &h);
-        glViewport(0, 0, w, h);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        // SELECT pauses: the simulation holds still and the device drops to its paused cap.
+        if (was_button_pressed(GP_BTN_SELECT))
+        {
+            paused = !paused;
+            set_paused(paused);
+            timestep.started = false;
+        }
 
-        glUseProgram(program);
-        glUniform1f(utime_loc, time);
-        glUniform2f(upos_loc, pos.x, pos.y);
-        glBindVertexArrayX(vao);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArrayX(0);
+        if (paused)
+            demo_render(1.0f, &demo);
+        else
+            timestep_run(&timestep, get_time_ns(), demo_tick, demo_render, &demo);
 
 		end_frame();
 	}
 
+    if (profile_path)
+        profile_dump(profile_path);
+
     glDeleteProgram(program);
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArraysX(1, &vao);
 
 	shutdown();
+    synth_shutdown(&synth);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <device.hpp>
+
+// Shared by both backends and by game_bench, which links no backend.
+#if defined(_WIN32)
+
+#include <windows.h>
+
+bool map_file(const char* path, mapped_file_t* file)
+{
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        LOG_ERROR("Failed to open %s (error %lu)", path, static_cast<unsigned long>(GetLastError()));
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(handle, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+    if (!mapping)
+    {
+        LOG_ERROR("Failed to map %s: empty or unreadable", path);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        LOG_ERROR("Failed to map %s (error %lu)", path, static_cast<unsigned long>(GetLastError()));
+        CloseHandle(mapping);
+        return false;
+    }
+
+    file->data = static_cast<const u8*>(data);
+    file->size = static_cast<size_t>(size.QuadPart);
+    file->handle = mapping;
+    return true;
+}
+
+void unmap_file(mapped_file_t* file)
+{
+    if (file->data)
+    {
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->handle);
+    }
+    file->data = nullptr;
+    file->size = 0;
+    file->handle = nullptr;
+}
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+
+bool map_file(const char* path, mapped_file_t* file)
+{
+    i32 fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        LOG_ERROR("Failed to open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        LOG_ERROR("Failed to map %s: empty or unreadable", path);
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        LOG_ERROR("Failed to map %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    // Streams read front to back; let the kernel read ahead aggressively.
+    madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    file->data = static_cast<const u8*>(data);
+    file->size = static_cast<size_t>(st.st_size);
+    file->handle = nullptr;
+    return true;
+}
+
+void unmap_file(mapped_file_t* file)
+{
+    if (file->data)
+        munmap(const_cast<u8*>(file->data), file->size);
+    file->data = nullptr;
+    file->size = 0;
+}
+
+#endif
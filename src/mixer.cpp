@@ -0,0 +1,593 @@
+#include <device.hpp>
+#include <mixer.hpp>
+#include <audio_stream.hpp>
+#include <effects.hpp>
+#include <pcm.hpp>
+#include <dsp.hpp>
+
+#define MIXER_MAX_PITCH 16.0f
+#define MIXER_MIN_PITCH (1.0f / 16.0f)
+// Source frames a stream voice can read per block, enough for a 16x rate ratio.
+#define MIXER_STREAM_FRAMES (MIXER_BLOCK_FRAMES * 16 + 2)
+
+static const f32 MIXER_S16_INV_SCALE = 1.0f / 32768.0f;
+static const f32 MIXER_FRAC_SCALE = 1.0f / 4294967296.0f;
+
+static void voice_gains(const mixer_t* mixer, const mixer_voice_t& voice, f32* l, f32* r)
+{
+    const mixer_voice_params_t& p = voice.params;
+    if (mixer->channels == 1)
+    {
+        *l = *r = p.gain;
+    }
+    else if (voice.source.channels == 1)
+    {
+        // Constant power pan for mono sources
+        f32 angle = (clamp(p.pan, -1.0f, 1.0f) + 1.0f) * 0.25f * 3.14159265f;
+        *l = p.gain * cosf(angle);
+        *r = p.gain * sinf(angle);
+    }
+    else
+    {
+        // Balance for stereo sources
+        *l = p.gain * clamp(1.0f - p.pan, 0.0f, 1.0f);
+        *r = p.gain * clamp(1.0f + p.pan, 0.0f, 1.0f);
+    }
+}
+
+static u64 voice_step(const mixer_t* mixer, const mixer_voice_t& voice)
+{
+    f64 pitch = clamp(voice.params.pitch, MIXER_MIN_PITCH, MIXER_MAX_PITCH);
+    f64 ratio = pitch * voice.source.sample_rate / mixer->sample_rate;
+    return static_cast<u64>(ratio * 4294967296.0);
+}
+
+// Linear interpolation while both taps are inside the source, so the loop needs no bounds checks.
+template <u32 CHANNELS>
+static u32 voice_interpolate(const i16* samples, u64 limit, u64 step, u64* position, f32* dst, u32 frames)
+{
+    u64 pos = *position;
+    u32 i = 0;
+    for (; i < frames && pos < limit; ++i)
+    {
+        const i16* a = samples + static_cast<u32>(pos >> 32) * CHANNELS;
+        f32 t = static_cast<u32>(pos) * MIXER_FRAC_SCALE;
+        for (u32 c = 0; c < CHANNELS; ++c)
+            dst[i * CHANNELS + c] = (a[c] + (a[c + CHANNELS] - a[c]) * t) * MIXER_S16_INV_SCALE;
+        pos += step;
+    }
+    *position = pos;
+    return i;
+}
+
+// Resamples up to `frames` source frames into `dst` and returns how many were produced.
+static u32 voice_fill(const mixer_t* mixer, mixer_voice_t& voice, f32* dst, u32 frames)
+{
+    const mixer_source_t& src = voice.source;
+    const u32 channels = static_cast<u32>(src.channels);
+    const u64 end = static_cast<u64>(src.frames) << 32;
+    const u64 step = voice_step(mixer, voice);
+    u32 written = 0;
+
+    // Unit rate on a whole frame is a straight format conversion.
+    if (step == (1ull << 32) && (voice.position & 0xFFFFFFFFull) == 0)
+    {
+        while (written < frames)
+        {
+            u32 index = static_cast<u32>(voice.position >> 32);
+            u32 count = frames - written;
+            if (count > src.frames - index)
+                count = src.frames - index;
+
+            pcm_s16_to_f32(src.samples + index * channels, dst + written * channels, count * channels);
+            written += count;
+            voice.position += static_cast<u64>(count) << 32;
+
+            if (voice.position >= end)
+            {
+                if (!voice.params.loop)
+                    break;
+                voice.position -= end;
+            }
+        }
+        return written;
+    }
+
+    const u64 limit = static_cast<u64>(src.frames - 1) << 32;
+    while (written < frames)
+    {
+        if (channels == 1)
+            written += voice_interpolate<1>(src.samples, limit, step, &voice.position, dst + written, frames - written);
+        else
+            written += voice_interpolate<2>(src.samples, limit, step, &voice.position, dst + written * 2, frames - written);
+        if (written == frames)
+            break;
+
+        // Last frame interpolates towards the loop start, or holds when not looping.
+        if (voice.position >= end)
+        {
+            if (!voice.params.loop)
+                break;
+            voice.position %= end;
+        }
+
+        u32 index = static_cast<u32>(voice.position >> 32);
+        u32 next = index + 1 < src.frames ? index + 1 : (voice.params.loop ? 0 : index);
+        f32 t = static_cast<u32>(voice.position) * MIXER_FRAC_SCALE;
+        const i16* a = src.samples + index * channels;
+        const i16* b = src.samples + next * channels;
+        for (u32 c = 0; c < channels; ++c)
+            dst[written * channels + c] = (a[c] + (b[c] - a[c]) * t) * MIXER_S16_INV_SCALE;
+
+        voice.position += step;
+        ++written;
+    }
+    return written;
+}
+
+// Streams are read through a peek of the frames this block touches. Only whole frames
+// passed over are consumed, so the fractional position and the interpolation tap
+// stay in the ring for the next block.
+static u32 voice_fill_stream(const mixer_t* mixer, mixer_voice_t& voice, i16* staging, f32* dst, u32 frames)
+{
+    audio_stream_t* stream = voice.source.stream;
+    const u32 channels = static_cast<u32>(voice.source.channels);
+    const u64 step = voice_step(mixer, voice);
+
+    // Every frame up to the end position, which also covers the last interpolation tap.
+    u64 end = ((voice.position + frames * step) >> 32) + 1;
+    u32 wanted = end < MIXER_STREAM_FRAMES ? static_cast<u32>(end) : MIXER_STREAM_FRAMES;
+    u32 available = audio_stream_peek(stream, staging, wanted);
+
+    u32 written = 0;
+    if (available >= 2)
+    {
+        const u64 limit = static_cast<u64>(available - 1) << 32;
+        if (channels == 1)
+            written = voice_interpolate<1>(staging, limit, step, &voice.position, dst, frames);
+        else
+            written = voice_interpolate<2>(staging, limit, step, &voice.position, dst, frames);
+    }
+
+    u64 passed = voice.position >> 32;
+    u32 consumed = passed < available ? static_cast<u32>(passed) : available;
+    audio_stream_skip(stream, consumed);
+    voice.position -= static_cast<u64>(consumed) << 32;
+
+    if (written < frames && !audio_stream_finished(stream))
+    {
+        // The decoder fell behind: play silence and pick up where it left off.
+        memset(dst + written * channels, 0, (frames - written) * channels * sizeof(f32));
+        written = frames;
+    }
+    return written;
+}
+
+static mixer_voice_t* find_voice(mixer_t* mixer, u32 id)
+{
+    if (id == 0)
+        return nullptr;
+    for (auto& voice : mixer->voices)
+        if (voice.id == id)
+            return &voice;
+    return nullptr;
+}
+
+static void voice_release(mixer_t* mixer, mixer_voice_t& voice)
+{
+    voice.id = 0;
+    mixer->playing[&voice - mixer->voices.data()].store(0, std::memory_order_release);
+}
+
+static void voice_start(mixer_t* mixer, u32 id, const mixer_source_t& source, const mixer_voice_params_t& params, u64 start)
+{
+    // Take a free voice, otherwise steal the lowest priority one, oldest first. Ids wrap,
+    // so age is their signed distance rather than a plain comparison.
+    mixer_voice_t* slot = nullptr;
+    for (auto& voice : mixer->voices)
+    {
+        if (voice.id == 0)
+        {
+            slot = &voice;
+            break;
+        }
+        if (!slot || voice.params.priority < slot->params.priority ||
+            (voice.params.priority == slot->params.priority && static_cast<i32>(voice.id - slot->id) < 0))
+            slot = &voice;
+    }
+    if (!slot || (slot->id != 0 && slot->params.priority > params.priority))
+        return;
+
+    slot->source = source;
+    slot->params = params;
+    if (slot->params.bus < 0 || slot->params.bus >= static_cast<i32>(mixer->buses.size()))
+        slot->params.bus = 0;
+    slot->position = 0;
+    slot->start = start;
+    voice_gains(mixer, *slot, &slot->gain_l, &slot->gain_r);
+
+    slot->id = id;
+    mixer->playing[slot - mixer->voices.data()].store(id, std::memory_order_release);
+}
+
+static void detach_effect(mixer_t* mixer, effect_t* effect)
+{
+    for (auto& bus : mixer->buses)
+    {
+        u32 kept = 0;
+        for (u32 i = 0; i < bus.effect_count; ++i)
+            if (bus.effects[i] != effect)
+                bus.effects[kept++] = bus.effects[i];
+        for (u32 i = kept; i < bus.effect_count; ++i)
+            bus.effects[i] = nullptr;
+        bus.effect_count = kept;
+    }
+    effect->attached.store(false, std::memory_order_release);
+}
+
+static void process_commands(mixer_t* mixer)
+{
+    mixer_command_t cmd;
+    while (mixer->commands.pop(&cmd))
+    {
+        if (cmd.type == MIXER_CMD_PLAY)
+        {
+            voice_start(mixer, cmd.target, cmd.source, cmd.params, cmd.frame);
+            mixer->started_id.store(cmd.target, std::memory_order_release);
+            continue;
+        }
+        if (cmd.type == MIXER_CMD_BUS_GAIN)
+        {
+            if (cmd.target < mixer->buses.size())
+                mixer->buses[cmd.target].gain = cmd.value;
+            continue;
+        }
+        if (cmd.type == MIXER_CMD_EFFECT_INSERT)
+        {
+            mixer_bus_t& bus = mixer->buses[cmd.target];
+            if (bus.effect_count < MIXER_BUS_EFFECTS)
+                bus.effects[bus.effect_count++] = cmd.effect;
+            else
+                cmd.effect->attached.store(false, std::memory_order_release);
+            continue;
+        }
+        if (cmd.type == MIXER_CMD_EFFECT_REMOVE)
+        {
+            detach_effect(mixer, cmd.effect);
+            continue;
+        }
+        if (cmd.type == MIXER_CMD_EFFECT_PARAM)
+        {
+            effect_set_param(cmd.effect, cmd.target, cmd.value);
+            continue;
+        }
+
+        mixer_voice_t* voice = find_voice(mixer, cmd.target);
+        if (!voice)
+            continue;
+
+        switch (cmd.type)
+        {
+        case MIXER_CMD_STOP: voice_release(mixer, *voice); break;
+        case MIXER_CMD_GAIN: voice->params.gain = cmd.value; break;
+        case MIXER_CMD_PAN: voice->params.pan = cmd.value; break;
+        case MIXER_CMD_PITCH: voice->params.pitch = cmd.value; break;
+        default: break;
+        }
+    }
+}
+
+static bool post_command(mixer_t* mixer, u8 type, u32 target, f32 value)
+{
+    mixer_command_t cmd;
+    cmd.type = type;
+    cmd.target = target;
+    cmd.value = value;
+    cmd.effect = nullptr;
+    return mixer->commands.push(cmd);
+}
+
+// Effects work on planar channels; mono buses are already planar.
+static void process_effects(mixer_t* mixer, mixer_bus_t& bus, u32 frames)
+{
+    f32* channels[2] = { bus.buffer.data(), nullptr };
+    if (mixer->channels == 2)
+    {
+        channels[0] = mixer->planar.data();
+        channels[1] = mixer->planar.data() + MIXER_BLOCK_FRAMES;
+        dsp_deinterleave(bus.buffer.data(), channels[0], channels[1], frames);
+    }
+
+    for (u32 i = 0; i < bus.effect_count; ++i)
+        effect_process(bus.effects[i], channels, frames);
+
+    if (mixer->channels == 2)
+        dsp_interleave(channels[0], channels[1], bus.buffer.data(), frames);
+}
+
+static void render_block(mixer_t* mixer, f32* samples, u32 frames)
+{
+    const u32 count = frames * mixer->channels;
+    for (auto& bus : mixer->buses)
+        memset(bus.buffer.data(), 0, count * sizeof(f32));
+
+    for (auto& voice : mixer->voices)
+    {
+        if (voice.id == 0)
+            continue;
+
+        // Scheduled voices begin on their exact frame within the block.
+        u32 offset = 0;
+        if (voice.start > mixer->clock)
+        {
+            if (voice.start - mixer->clock >= frames)
+                continue;
+            offset = static_cast<u32>(voice.start - mixer->clock);
+        }
+        const u32 length = frames - offset;
+
+        f32 l, r;
+        voice_gains(mixer, voice, &l, &r);
+        f32 dl = (l - voice.gain_l) / length;
+        f32 dr = (r - voice.gain_r) / length;
+
+        f32* scratch = mixer->scratch.data();
+        u32 produced = voice.source.stream
+            ? voice_fill_stream(mixer, voice, mixer->stream_scratch.data(), scratch, length)
+            : voice_fill(mixer, voice, scratch, length);
+        f32* bus = mixer->buses[voice.params.bus].buffer.data() + offset * mixer->channels;
+
+        if (mixer->channels == 1)
+            dsp_mix_to_mono(bus, scratch, voice.source.channels, produced, voice.gain_l, dl);
+        else if (voice.source.channels == 1)
+            dsp_mix_mono_to_stereo(bus, scratch, produced, voice.gain_l, voice.gain_r, dl, dr);
+        else
+            dsp_mix_stereo_to_stereo(bus, scratch, produced, voice.gain_l, voice.gain_r, dl, dr);
+
+        voice.gain_l = l;
+        voice.gain_r = r;
+        if (produced < length)
+            voice_release(mixer, voice);
+    }
+
+    for (auto& bus : mixer->buses)
+        if (bus.effect_count > 0)
+            process_effects(mixer, bus, frames);
+
+    memset(samples, 0, count * sizeof(f32));
+    for (auto& bus : mixer->buses)
+        dsp_mix_scaled(samples, bus.buffer.data(), count, bus.gain);
+    mixer->clock += frames;
+}
+
+bool mixer_init(mixer_t* mixer, u32 sample_rate, i32 channels, i32 max_frames, i32 max_voices, i32 bus_count)
+{
+    if (channels < 1 || channels > 2)
+    {
+        LOG_ERROR("Mixer supports 1 or 2 output channels, got %d", channels);
+        return false;
+    }
+    if (max_frames <= 0 || max_voices <= 0 || bus_count <= 0)
+    {
+        LOG_ERROR("Invalid mixer configuration");
+        return false;
+    }
+
+    mixer->sample_rate = sample_rate;
+    mixer->channels = channels;
+    mixer->voices.assign(max_voices, mixer_voice_t());
+    mixer->buses.assign(bus_count, mixer_bus_t());
+    for (auto& bus : mixer->buses)
+        bus.buffer.assign(MIXER_BLOCK_FRAMES * channels, 0.0f);
+    mixer->scratch.assign(MIXER_BLOCK_FRAMES * 2, 0.0f);
+    mixer->stream_scratch.assign(MIXER_STREAM_FRAMES * 2, 0);
+    mixer->planar.assign(MIXER_BLOCK_FRAMES * 2, 0.0f);
+    mixer->output.assign(max_frames * channels, 0.0f);
+
+    mixer->playing.reset(new std::atomic<u32>[max_voices]);
+    for (i32 i = 0; i < max_voices; ++i)
+        mixer->playing[i].store(0);
+    mixer->clock = 0;
+    mixer->next_id = 1;
+    mixer->started_id.store(0);
+
+    mixer_command_t cmd;
+    while (mixer->commands.pop(&cmd)) {}
+
+    LOG_INFO("Mixer initialized: %d voices, %d buses", max_voices, bus_count);
+    return true;
+}
+
+void mixer_shutdown(mixer_t* mixer)
+{
+    // Effects still queued for insertion were never attached to a bus.
+    mixer_command_t cmd;
+    while (mixer->commands.pop(&cmd))
+        if (cmd.type == MIXER_CMD_EFFECT_INSERT)
+            cmd.effect->attached.store(false, std::memory_order_release);
+    for (auto& bus : mixer->buses)
+        for (u32 i = 0; i < bus.effect_count; ++i)
+            bus.effects[i]->attached.store(false, std::memory_order_release);
+
+    mixer->voices.clear();
+    mixer->buses.clear();
+    mixer->scratch.clear();
+    mixer->stream_scratch.clear();
+    mixer->planar.clear();
+    mixer->output.clear();
+    mixer->playing.reset();
+}
+
+mixer_source_t mixer_stream_source(audio_stream_t* stream)
+{
+    mixer_source_t source;
+    source.channels = stream->info.channels;
+    source.sample_rate = stream->info.sample_rate;
+    source.frames = stream->info.frames;
+    source.stream = stream;
+    return source;
+}
+
+u32 mixer_play(mixer_t* mixer, const mixer_source_t& source, const mixer_voice_params_t& params)
+{
+    return mixer_play_at(mixer, source, params, 0);
+}
+
+u32 mixer_play_at(mixer_t* mixer, const mixer_source_t& source, const mixer_voice_params_t& params, u64 frame)
+{
+    if (source.channels < 1 || source.channels > 2)
+        return 0;
+    if (!source.stream && (!source.samples || source.frames == 0))
+        return 0;
+
+    mixer_command_t cmd;
+    cmd.type = MIXER_CMD_PLAY;
+    cmd.target = mixer->next_id;
+    cmd.value = 0.0f;
+    cmd.source = source;
+    cmd.params = params;
+    cmd.effect = nullptr;
+    cmd.frame = frame;
+    if (!mixer->commands.push(cmd))
+    {
+        LOG_WARN("Mixer command queue full, dropping sound");
+        return 0;
+    }
+
+    mixer->next_id++;
+    if (mixer->next_id == 0)
+        mixer->next_id = 1;
+    return cmd.target;
+}
+
+void mixer_stop(mixer_t* mixer, u32 voice)
+{
+    post_command(mixer, MIXER_CMD_STOP, voice, 0.0f);
+}
+
+bool mixer_is_playing(const mixer_t* mixer, u32 voice)
+{
+    if (voice == 0)
+        return false;
+
+    // Ids are issued in order, so anything newer than the last started id is still queued.
+    u32 started = mixer->started_id.load(std::memory_order_acquire);
+    if (static_cast<i32>(voice - started) > 0)
+        return true;
+
+    for (size_t i = 0; i < mixer->voices.size(); ++i)
+        if (mixer->playing[i].load(std::memory_order_acquire) == voice)
+            return true;
+    return false;
+}
+
+void mixer_set_gain(mixer_t* mixer, u32 voice, f32 gain)
+{
+    post_command(mixer, MIXER_CMD_GAIN, voice, gain);
+}
+
+void mixer_set_pan(mixer_t* mixer, u32 voice, f32 pan)
+{
+    post_command(mixer, MIXER_CMD_PAN, voice, pan);
+}
+
+void mixer_set_pitch(mixer_t* mixer, u32 voice, f32 pitch)
+{
+    post_command(mixer, MIXER_CMD_PITCH, voice, pitch);
+}
+
+void mixer_set_bus_gain(mixer_t* mixer, i32 bus, f32 gain)
+{
+    if (bus >= 0)
+        post_command(mixer, MIXER_CMD_BUS_GAIN, static_cast<u32>(bus), gain);
+}
+
+bool mixer_bus_insert_effect(mixer_t* mixer, i32 bus, effect_t* effect)
+{
+    if (bus < 0 || bus >= static_cast<i32>(mixer->buses.size()))
+        return false;
+    if (effect->sample_rate != mixer->sample_rate || effect->channels != mixer->channels)
+    {
+        LOG_ERROR("Effect format %u Hz x%d does not match the mixer (%u Hz x%d)",
+            effect->sample_rate, effect->channels, mixer->sample_rate, mixer->channels);
+        return false;
+    }
+    if (effect_attached(effect))
+    {
+        LOG_WARN("Effect is already attached to a mixer bus");
+        return false;
+    }
+
+    // Not attached, so the audio thread cannot be touching it yet.
+    effect_reset(effect);
+    effect->attached.store(true, std::memory_order_release);
+
+    mixer_command_t cmd;
+    cmd.type = MIXER_CMD_EFFECT_INSERT;
+    cmd.target = static_cast<u32>(bus);
+    cmd.value = 0.0f;
+    cmd.effect = effect;
+    if (!mixer->commands.push(cmd))
+    {
+        effect->attached.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void mixer_bus_remove_effect(mixer_t* mixer, effect_t* effect)
+{
+    mixer_command_t cmd;
+    cmd.type = MIXER_CMD_EFFECT_REMOVE;
+    cmd.target = 0;
+    cmd.value = 0.0f;
+    cmd.effect = effect;
+    if (!mixer->commands.push(cmd))
+        LOG_WARN("Mixer command queue full, effect not removed");
+}
+
+void mixer_set_effect_param(mixer_t* mixer, effect_t* effect, u32 param, f32 value)
+{
+    mixer_command_t cmd;
+    cmd.type = MIXER_CMD_EFFECT_PARAM;
+    cmd.target = param;
+    cmd.value = value;
+    cmd.effect = effect;
+    mixer->commands.push(cmd);
+}
+
+void mixer_render_f32(mixer_t* mixer, f32* samples, i32 frames)
+{
+    process_commands(mixer);
+
+    while (frames > 0)
+    {
+        u32 count = frames < MIXER_BLOCK_FRAMES ? frames : MIXER_BLOCK_FRAMES;
+        render_block(mixer, samples, count);
+        samples += count * mixer->channels;
+        frames -= count;
+    }
+}
+
+void mixer_render(mixer_t* mixer, i16* samples, i32 frames)
+{
+    const i32 capacity = static_cast<i32>(mixer->output.size()) / mixer->channels;
+    while (frames > 0)
+    {
+        i32 count = frames < capacity ? frames : capacity;
+        mixer_render_f32(mixer, mixer->output.data(), count);
+        pcm_f32_to_s16(mixer->output.data(), samples, count * mixer->channels);
+        samples += count * mixer->channels;
+        frames -= count;
+    }
+}
+
+void mixer_audio_callback(i16* samples, i32 frames, void* userdata)
+{
+    mixer_render(static_cast<mixer_t*>(userdata), samples, frames);
+}
+
+void mixer_audio_callback_f32(f32* samples, i32 frames, void* userdata)
+{
+    mixer_render_f32(static_cast<mixer_t*>(userdata), samples, frames);
+}
@@ -0,0 +1,232 @@
+#include <pcm.hpp>
+#include <simd.hpp>
+
+#include <cmath>
+
+static const f32 PCM_S16_SCALE = 32767.0f;
+static const f32 PCM_S16_INV_SCALE = 1.0f / 32768.0f;
+// Maps a signed 32-bit random value to [-0.5, 0.5) LSB.
+static const f32 PCM_DITHER_SCALE = 1.0f / 4294967296.0f;
+
+static inline f32 clamp_unit(f32 v)
+{
+    return v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+}
+
+static inline i16 saturate_s16(i32 v)
+{
+    return static_cast<i16>(v < -32768 ? -32768 : v > 32767 ? 32767 : v);
+}
+
+static inline u32 xorshift32(u32 x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Sum of two uniform values, giving a triangular distribution over [-1, 1) LSB.
+static inline f32 dither_tpdf(u32* state)
+{
+    u32 a = xorshift32(*state);
+    u32 b = xorshift32(a);
+    *state = b;
+    return static_cast<f32>(static_cast<i32>(a)) * PCM_DITHER_SCALE +
+           static_cast<f32>(static_cast<i32>(b)) * PCM_DITHER_SCALE;
+}
+
+// The scalar loops start at `i` so the SIMD paths can finish their tails with them.
+// Sample i always draws from lane i % 4, which keeps the dither sequence identical
+// between the SIMD and scalar paths.
+static void f32_to_s16_scalar(const f32* src, i16* dst, u32 i, u32 count)
+{
+    for (; i < count; ++i)
+        dst[i] = saturate_s16(static_cast<i32>(lrintf(clamp_unit(src[i]) * PCM_S16_SCALE)));
+}
+
+static void f32_to_s16_dither_scalar(const f32* src, i16* dst, u32 i, u32 count, pcm_dither_t* dither)
+{
+    for (; i < count; ++i)
+    {
+        f32 v = clamp_unit(src[i]) * PCM_S16_SCALE + dither_tpdf(&dither->state[i & 3]);
+        dst[i] = saturate_s16(static_cast<i32>(lrintf(v)));
+    }
+}
+
+static void s16_to_f32_scalar(const i16* src, f32* dst, u32 i, u32 count)
+{
+    for (; i < count; ++i)
+        dst[i] = src[i] * PCM_S16_INV_SCALE;
+}
+
+#if defined(SIMD_NEON)
+// Rounds to nearest, ties to even, like lrintf() and the SSE2 conversion. ARMv7 only
+// has a truncating conversion, so it rounds in float first: adding and removing
+// 1.5 * 2^23 leaves no fraction bits for |v| < 2^22, well past the S16 range. Larger
+// values still saturate in vqmovn.
+static inline int32x4_t round_s32_x4(float32x4_t v)
+{
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(v);
+#else
+    const float32x4_t magic = vdupq_n_f32(12582912.0f);
+    return vcvtq_s32_f32(vsubq_f32(vaddq_f32(v, magic), magic));
+#endif
+}
+#endif
+
+void pcm_f32_to_s16(const f32* src, i16* dst, u32 count)
+{
+    u32 i = 0;
+
+    // Both vectors are loaded before the store, and the S16 store never overtakes the
+    // next float load, so converting in place is safe.
+#if defined(SIMD_NEON)
+    const float32x4_t scale = vdupq_n_f32(PCM_S16_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        // vqmovn saturates, so only the float -> int conversion needs care.
+        float32x4_t a = vmulq_f32(vld1q_f32(src + i), scale);
+        float32x4_t b = vmulq_f32(vld1q_f32(src + i + 4), scale);
+        int32x4_t ia = round_s32_x4(a);
+        int32x4_t ib = round_s32_x4(b);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+    }
+#elif defined(SIMD_SSE2)
+    const __m128 scale = _mm_set1_ps(PCM_S16_SCALE);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        // Out of range floats convert to INT_MIN, so clamp before converting.
+        __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi), scale);
+        __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), lo), hi), scale);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+#endif
+
+    f32_to_s16_scalar(src, dst, i, count);
+}
+
+#if defined(SIMD_NEON)
+static inline uint32x4_t xorshift32x4(uint32x4_t x)
+{
+    x = veorq_u32(x, vshlq_n_u32(x, 13));
+    x = veorq_u32(x, vshrq_n_u32(x, 17));
+    x = veorq_u32(x, vshlq_n_u32(x, 5));
+    return x;
+}
+
+static inline float32x4_t dither_tpdf_x4(uint32x4_t* state)
+{
+    const float32x4_t scale = vdupq_n_f32(PCM_DITHER_SCALE);
+    uint32x4_t a = xorshift32x4(*state);
+    uint32x4_t b = xorshift32x4(a);
+    *state = b;
+    return vaddq_f32(vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(a)), scale),
+                     vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(b)), scale));
+}
+#elif defined(SIMD_SSE2)
+static inline __m128i xorshift32x4(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    return x;
+}
+
+static inline __m128 dither_tpdf_x4(__m128i* state)
+{
+    const __m128 scale = _mm_set1_ps(PCM_DITHER_SCALE);
+    __m128i a = xorshift32x4(*state);
+    __m128i b = xorshift32x4(a);
+    *state = b;
+    return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(a), scale), _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+}
+#endif
+
+void pcm_f32_to_s16_dither(const f32* src, i16* dst, u32 count, pcm_dither_t* dither)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const float32x4_t scale = vdupq_n_f32(PCM_S16_SCALE);
+    const float32x4_t lo = vdupq_n_f32(-1.0f);
+    const float32x4_t hi = vdupq_n_f32(1.0f);
+    uint32x4_t state = vld1q_u32(dither->state);
+    for (; i + 8 <= count; i += 8)
+    {
+        // Clamp first so values past full scale saturate the same way as the scalar path.
+        float32x4_t a = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi), scale);
+        float32x4_t b = vmulq_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), lo), hi), scale);
+        a = vaddq_f32(a, dither_tpdf_x4(&state));
+        b = vaddq_f32(b, dither_tpdf_x4(&state));
+        int32x4_t ia = round_s32_x4(a);
+        int32x4_t ib = round_s32_x4(b);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(ia), vqmovn_s32(ib)));
+    }
+    vst1q_u32(dither->state, state);
+#elif defined(SIMD_SSE2)
+    const __m128 scale = _mm_set1_ps(PCM_S16_SCALE);
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->state));
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi), scale);
+        __m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), lo), hi), scale);
+        a = _mm_add_ps(a, dither_tpdf_x4(&state));
+        b = _mm_add_ps(b, dither_tpdf_x4(&state));
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->state), state);
+#endif
+
+    f32_to_s16_dither_scalar(src, dst, i, count, dither);
+}
+
+void pcm_s16_to_f32(const i16* src, f32* dst, u32 count)
+{
+    u32 i = 0;
+
+#if defined(SIMD_NEON)
+    const float32x4_t scale = vdupq_n_f32(PCM_S16_INV_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+#elif defined(SIMD_SSE2)
+    const __m128 scale = _mm_set1_ps(PCM_S16_INV_SCALE);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Sign extend by unpacking into the high half and shifting back down.
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+#endif
+
+    s16_to_f32_scalar(src, dst, i, count);
+}
+
+void pcm_f32_to_s16_scalar(const f32* src, i16* dst, u32 count)
+{
+    f32_to_s16_scalar(src, dst, 0, count);
+}
+
+void pcm_f32_to_s16_dither_scalar(const f32* src, i16* dst, u32 count, pcm_dither_t* dither)
+{
+    f32_to_s16_dither_scalar(src, dst, 0, count, dither);
+}
+
+void pcm_s16_to_f32_scalar(const i16* src, f32* dst, u32 count)
+{
+    s16_to_f32_scalar(src, dst, 0, count);
+}
@@ -0,0 +1,218 @@
+#include <device.hpp>
+#include <perf_counters.hpp>
+
+#if defined(__linux__)
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <atomic>
+
+// One group per thread. The leader is published last, so the game thread only reads
+// a group once every member is open.
+struct perf_group_t
+{
+    std::atomic<i32> leader;
+    i32 fds[PERF_COUNTER_COUNT];
+    u32 counters[PERF_COUNTER_COUNT];		// PERF_COUNTER_* of each member, in read order
+    u32 count;
+    u32 mask;
+    bool primed;
+    u64 last[PERF_COUNTER_COUNT];
+};
+
+static bool perf_enabled = false;
+static perf_group_t perf_groups[PERF_THREAD_COUNT];
+static perf_stats_t perf_stats;
+
+static void perf_event_config(u32 counter, struct perf_event_attr* attr)
+{
+    const u64 read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (counter)
+    {
+    case PERF_COUNTER_CYCLES:        attr->type = PERF_TYPE_HARDWARE; attr->config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case PERF_COUNTER_INSTRUCTIONS:  attr->type = PERF_TYPE_HARDWARE; attr->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case PERF_COUNTER_L1D_MISSES:    attr->type = PERF_TYPE_HW_CACHE; attr->config = PERF_COUNT_HW_CACHE_L1D | read_miss; break;
+    case PERF_COUNTER_LLC_MISSES:    attr->type = PERF_TYPE_HW_CACHE; attr->config = PERF_COUNT_HW_CACHE_LL | read_miss; break;
+    default:                         attr->type = PERF_TYPE_HARDWARE; attr->config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    }
+}
+
+static i32 perf_event_open(u32 counter, i32 group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    perf_event_config(counter, &attr);
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = group_fd < 0;		// The leader starts the whole group once it is complete
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<i32>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+// Cumulative counts of a group, scaled up when the PMU was shared.
+static bool perf_group_read(perf_group_t* group, u64* values, bool* multiplexed)
+{
+    i32 leader = group->leader.load(std::memory_order_acquire);
+    if (leader < 0)
+        return false;
+
+    u64 data[3 + PERF_COUNTER_COUNT];
+    ssize_t bytes = read(leader, data, sizeof(data));
+    if (bytes < static_cast<ssize_t>((3 + group->count) * sizeof(u64)) || data[0] != group->count)
+        return false;
+
+    const u64 enabled = data[1], running = data[2];
+    *multiplexed = running < enabled;
+    for (u32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+        values[i] = 0;
+    for (u32 i = 0; i < group->count; ++i)
+    {
+        u64 value = data[3 + i];
+        if (*multiplexed && running > 0)
+            value = static_cast<u64>(static_cast<f64>(value) * enabled / running);
+        values[group->counters[i]] = value;
+    }
+    return true;
+}
+
+// Counts since the previous call into `sample`.
+static void perf_group_sample(perf_group_t* group, perf_sample_t* sample)
+{
+    u64 values[PERF_COUNTER_COUNT];
+    bool multiplexed = false;
+    if (!perf_group_read(group, values, &multiplexed))
+        return;
+
+    if (group->primed)
+    {
+        sample->mask = group->mask;
+        sample->multiplexed = multiplexed;
+        for (u32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+            sample->values[i] = values[i] >= group->last[i] ? values[i] - group->last[i] : 0;
+    }
+    group->primed = true;
+    for (u32 i = 0; i < PERF_COUNTER_COUNT; ++i)
+        group->last[i] = values[i];
+}
+
+bool perf_counters_init(bool enabled)
+{
+    memset(&perf_stats, 0, sizeof(perf_stats));
+    for (u32 t = 0; t < PERF_THREAD_COUNT; ++t)
+    {
+        perf_groups[t].leader.store(-1, std::memory_order_relaxed);
+        perf_groups[t].count = 0;
+        perf_groups[t].mask = 0;
+        perf_groups[t].primed = false;
+    }
+
+    perf_enabled = enabled;
+    if (!enabled)
+        return true;
+
+    perf_counters_attach(PERF_THREAD_MAIN);
+    if (perf_groups[PERF_THREAD_MAIN].leader.load(std::memory_order_relaxed) < 0)
+    {
+        perf_enabled = false;
+        return false;
+    }
+    return true;
+}
+
+void perf_counters_shutdown()
+{
+    for (u32 t = 0; t < PERF_THREAD_COUNT; ++t)
+    {
+        perf_group_t& group = perf_groups[t];
+        for (u32 i = 0; i < group.count; ++i)
+            close(group.fds[i]);
+        group.leader.store(-1, std::memory_order_relaxed);
+        group.count = 0;
+        group.mask = 0;
+    }
+    perf_enabled = false;
+}
+
+void perf_counters_attach(u32 thread)
+{
+    ASSERT(thread < PERF_THREAD_COUNT, "Invalid perf thread %u", thread);
+    perf_group_t& group = perf_groups[thread];
+    if (!perf_enabled || group.count > 0)
+        return;
+
+    // Cycles lead; a PMU without a counter for one of the others just leaves it out.
+    i32 leader = -1;
+    for (u32 counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+    {
+        i32 fd = perf_event_open(counter, leader);
+        if (fd < 0)
+        {
+            if (counter == PERF_COUNTER_CYCLES)
+            {
+                LOG_WARN("Performance counters unavailable (%s), check /proc/sys/kernel/perf_event_paranoid", strerror(errno));
+                return;
+            }
+            continue;
+        }
+        if (leader < 0)
+            leader = fd;
+        group.fds[group.count] = fd;
+        group.counters[group.count] = counter;
+        group.count++;
+        group.mask |= 1u << counter;
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    group.leader.store(leader, std::memory_order_release);
+    if (group.mask != (1u << PERF_COUNTER_COUNT) - 1)
+        LOG_WARN("Only %u of %u performance counters available on thread %u", group.count, PERF_COUNTER_COUNT, thread);
+}
+
+void perf_counters_begin()
+{
+    if (!perf_enabled)
+        return;
+
+    // Only the end of the frame is sampled, so this just moves the baseline.
+    perf_sample_t skipped{};
+    perf_group_sample(&perf_groups[PERF_THREAD_MAIN], &skipped);
+}
+
+void perf_counters_end()
+{
+    if (!perf_enabled)
+        return;
+
+    perf_group_sample(&perf_groups[PERF_THREAD_MAIN], &perf_stats.main);
+    perf_group_sample(&perf_groups[PERF_THREAD_AUDIO], &perf_stats.audio);
+}
+
+void perf_counters_get(perf_stats_t* stats)
+{
+    *stats = perf_stats;
+}
+
+#else
+
+bool perf_counters_init(bool enabled)
+{
+    if (enabled)
+        LOG_WARN("Performance counters are only available on Linux");
+    return !enabled;
+}
+
+void perf_counters_shutdown() {}
+void perf_counters_attach(u32) {}
+void perf_counters_begin() {}
+void perf_counters_end() {}
+
+void perf_counters_get(perf_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif
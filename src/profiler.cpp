@@ -0,0 +1,122 @@
+#include <device.hpp>
+#include <profiler.hpp>
+
+#if defined(GAME_PROFILE)
+
+#include <atomic>
+#include <vector>
+
+struct profile_event_t
+{
+    const char* name;
+    u64 begin_ns;
+    u64 end_ns;
+};
+
+// Written only by its thread. head counts every scope recorded, so the reader can tell
+// which slots the writer has wrapped around to while it was copying.
+struct profile_thread_t
+{
+    std::atomic<u64> head;
+    const char* name;
+    profile_event_t events[PROFILE_EVENTS];
+};
+
+static profile_thread_t profile_threads[PROFILE_THREADS];
+static std::atomic<u32> profile_thread_count(0);
+static thread_local profile_thread_t* profile_current = nullptr;
+static thread_local bool profile_claimed = false;
+
+static profile_thread_t* profile_thread()
+{
+    if (!profile_claimed)
+    {
+        profile_claimed = true;
+        u32 index = profile_thread_count.fetch_add(1, std::memory_order_relaxed);
+        if (index < PROFILE_THREADS)
+            profile_current = &profile_threads[index];
+    }
+    return profile_current;
+}
+
+void profile_thread_name(const char* name)
+{
+    profile_thread_t* thread = profile_thread();
+    if (thread)
+        thread->name = name;
+}
+
+void profile_record(const char* name, u64 begin_ns, u64 end_ns)
+{
+    profile_thread_t* thread = profile_thread();
+    if (!thread)
+        return;
+
+    u64 head = thread->head.load(std::memory_order_relaxed);
+    profile_event_t& event = thread->events[head & (PROFILE_EVENTS - 1)];
+    event.name = name;
+    event.begin_ns = begin_ns;
+    event.end_ns = end_ns;
+    thread->head.store(head + 1, std::memory_order_release);
+}
+
+bool profile_dump(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        LOG_ERROR("Failed to open profile trace %s", path);
+        return false;
+    }
+
+    std::vector<profile_event_t> events(PROFILE_EVENTS);
+    u32 threads = profile_thread_count.load(std::memory_order_relaxed);
+    if (threads > PROFILE_THREADS)
+        threads = PROFILE_THREADS;
+
+    u64 written = 0;
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (u32 t = 0; t < threads; ++t)
+    {
+        profile_thread_t& thread = profile_threads[t];
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            t > 0 ? ",\n" : "", t, thread.name ? thread.name : "thread");
+
+        u64 head = thread.head.load(std::memory_order_acquire);
+        u64 first = head > PROFILE_EVENTS ? head - PROFILE_EVENTS : 0;
+        for (u64 i = first; i < head; ++i)
+            events[i - first] = thread.events[i & (PROFILE_EVENTS - 1)];
+
+        // Slots the writer reached since the copy started may hold newer scopes.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        u64 after = thread.head.load(std::memory_order_relaxed);
+        u64 valid = after >= PROFILE_EVENTS ? after - PROFILE_EVENTS + 1 : 0;
+
+        for (u64 i = first > valid ? first : valid; i < head; ++i)
+        {
+            const profile_event_t& event = events[i - first];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, t, event.begin_ns * 1e-3, (event.end_ns - event.begin_ns) * 1e-3);
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = !ferror(file);
+    fclose(file);
+    if (ok)
+        LOG_INFO("Wrote %llu profile scopes from %u threads to %s", static_cast<unsigned long long>(written), threads, path);
+    else
+        LOG_ERROR("Failed to write profile trace %s", path);
+    return ok;
+}
+
+#else
+
+bool profile_dump(const char* path)
+{
+    LOG_WARN("Profiling is compiled out, rebuild with GAME_PROFILE to write %s", path);
+    return false;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <device.hpp>
+#include <resampler.hpp>
+#include <pcm.hpp>
+#include <simd.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+struct resampler_quality_t
+{
+    u32 taps;
+    f64 beta;		// Kaiser window shape
+    f64 rolloff;	// Cutoff as a fraction of the lower Nyquist frequency
+};
+
+static const resampler_quality_t RESAMPLER_QUALITIES[] =
+{
+    { 8, 5.0, 0.85 },
+    { 16, 7.0, 0.90 },
+    { 32, 9.0, 0.94 },
+};
+
+static u32 gcd(u32 a, u32 b)
+{
+    while (b)
+    {
+        u32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static f64 bessel_i0(f64 x)
+{
+    f64 sum = 1.0, term = 1.0;
+    for (i32 k = 1; k < 32; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+// Tap k of phase p sits (k - (taps / 2 - 1) - p / L) input frames from the output point.
+static void design_filter(resampler_t* r, const resampler_quality_t& quality)
+{
+    const u32 taps = quality.taps;
+    const f64 ratio = static_cast<f64>(r->out_rate) / r->in_rate;
+    const f64 cutoff = 0.5 * quality.rolloff * (ratio < 1.0 ? ratio : 1.0);
+    const f64 half = taps * 0.5;
+    const f64 norm = bessel_i0(quality.beta);
+
+    r->coeffs.assign(r->phases * taps, 0.0f);
+    for (u32 p = 0; p < r->phases; ++p)
+    {
+        f32* h = &r->coeffs[p * taps];
+        f64 sum = 0.0;
+        for (u32 k = 0; k < taps; ++k)
+        {
+            f64 x = static_cast<f64>(k) - (half - 1.0) - static_cast<f64>(p) / r->phases;
+            f64 t = x / half;
+            f64 window = t <= -1.0 || t >= 1.0 ? 0.0 : bessel_i0(quality.beta * sqrt(1.0 - t * t)) / norm;
+            f64 arg = 2.0 * cutoff * x;
+            f64 sinc = fabs(arg) < 1e-9 ? 1.0 : sin(3.14159265358979323846 * arg) / (3.14159265358979323846 * arg);
+            f64 v = 2.0 * cutoff * sinc * window;
+            h[k] = static_cast<f32>(v);
+            sum += v;
+        }
+        // Unity gain at DC for every phase, so no phase-dependent ripple.
+        for (u32 k = 0; k < taps; ++k)
+            h[k] = static_cast<f32>(h[k] / sum);
+    }
+}
+
+// taps is a multiple of 4 on every quality level.
+static inline f32 dot_mono(const f32* x, const f32* h, u32 taps)
+{
+#if defined(SIMD_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (u32 k = 0; k < taps; k += 4)
+        acc = vmlaq_f32(acc, vld1q_f32(x + k), vld1q_f32(h + k));
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#elif defined(SIMD_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (u32 k = 0; k < taps; k += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    return _mm_cvtss_f32(acc);
+#else
+    f32 acc = 0.0f;
+    for (u32 k = 0; k < taps; ++k)
+        acc += x[k] * h[k];
+    return acc;
+#endif
+}
+
+// Interleaved stereo: each coefficient is duplicated across an L/R pair in registers.
+static inline void dot_stereo(const f32* x, const f32* h, u32 taps, f32* out)
+{
+#if defined(SIMD_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+    for (u32 k = 0; k < taps; k += 4)
+    {
+        float32x4_t c = vld1q_f32(h + k);
+        float32x4x2_t cc = vzipq_f32(c, c);
+        acc0 = vmlaq_f32(acc0, vld1q_f32(x + 2 * k), cc.val[0]);
+        acc1 = vmlaq_f32(acc1, vld1q_f32(x + 2 * k + 4), cc.val[1]);
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    vst1_f32(out, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+#elif defined(SIMD_SSE2)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    for (u32 k = 0; k < taps; k += 4)
+    {
+        __m128 c = _mm_loadu_ps(h + k);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + 2 * k), _mm_unpacklo_ps(c, c)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + 2 * k + 4), _mm_unpackhi_ps(c, c)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    out[0] = _mm_cvtss_f32(acc);
+    out[1] = _mm_cvtss_f32(_mm_shuffle_ps(acc, acc, 1));
+#else
+    f32 l = 0.0f, r = 0.0f;
+    for (u32 k = 0; k < taps; ++k)
+    {
+        l += x[2 * k] * h[k];
+        r += x[2 * k + 1] * h[k];
+    }
+    out[0] = l;
+    out[1] = r;
+#endif
+}
+
+bool resampler_init(resampler_t* resampler, u32 in_rate, u32 out_rate, i32 channels, u8 quality, u32 max_input_frames)
+{
+    if (in_rate == 0 || out_rate == 0 || channels < 1 || channels > 2 || quality > RESAMPLER_QUALITY_HIGH)
+    {
+        LOG_ERROR("Invalid resampler configuration");
+        return false;
+    }
+
+    u32 g = gcd(in_rate, out_rate);
+    u32 up = out_rate / g;
+    u32 down = in_rate / g;
+    if (up > RESAMPLER_MAX_PHASES)
+    {
+        LOG_ERROR("Resampling %u Hz to %u Hz needs %u phases, more than %d", in_rate, out_rate, up, RESAMPLER_MAX_PHASES);
+        return false;
+    }
+
+    resampler->in_rate = in_rate;
+    resampler->out_rate = out_rate;
+    resampler->phases = up;
+    resampler->step_int = down / up;
+    resampler->step_frac = down % up;
+    resampler->channels = channels;
+    resampler->taps = RESAMPLER_QUALITIES[quality].taps;
+    design_filter(resampler, RESAMPLER_QUALITIES[quality]);
+
+    resampler->capacity = resampler->taps + max_input_frames;
+    resampler->buffer.assign(resampler->capacity * channels, 0.0f);
+    resampler_reset(resampler);
+    return true;
+}
+
+void resampler_reset(resampler_t* resampler)
+{
+    // taps / 2 - 1 frames of silence put the first output on the first input frame.
+    std::fill(resampler->buffer.begin(), resampler->buffer.end(), 0.0f);
+    resampler->buffered = resampler->taps / 2 - 1;
+    resampler->position = 0;
+    resampler->phase = 0;
+}
+
+u32 resampler_input_needed(const resampler_t* resampler, u32 out_frames)
+{
+    if (out_frames == 0)
+        return 0;
+
+    // Start of the last output's filter, relative to the current position.
+    u64 advance = (static_cast<u64>(resampler->step_int) * resampler->phases + resampler->step_frac) * (out_frames - 1) + resampler->phase;
+    u64 last = resampler->position + advance / resampler->phases;
+    u64 end = last + resampler->taps;
+    return end > resampler->buffered ? static_cast<u32>(end - resampler->buffered) : 0;
+}
+
+u32 resampler_process(resampler_t* resampler, const f32* in, u32 in_frames, f32* out, u32 max_out)
+{
+    resampler_t* r = resampler;
+    const u32 channels = static_cast<u32>(r->channels);
+    const u32 taps = r->taps;
+
+    if (in_frames > r->capacity - r->buffered)
+        in_frames = r->capacity - r->buffered;
+    memcpy(&r->buffer[r->buffered * channels], in, in_frames * channels * sizeof(f32));
+    r->buffered += in_frames;
+
+    const f32* buffer = r->buffer.data();
+    const f32* coeffs = r->coeffs.data();
+    u32 position = r->position;
+    u32 phase = r->phase;
+    u32 produced = 0;
+    while (produced < max_out && position + taps <= r->buffered)
+    {
+        const f32* h = coeffs + phase * taps;
+        if (channels == 1)
+            out[produced] = dot_mono(buffer + position, h, taps);
+        else
+            dot_stereo(buffer + position * 2, h, taps, out + produced * 2);
+        ++produced;
+
+        position += r->step_int;
+        phase += r->step_frac;
+        if (phase >= r->phases)
+        {
+            phase -= r->phases;
+            ++position;
+        }
+    }
+
+    // Keep only the frames later outputs still read.
+    u32 keep_from = position < r->buffered ? position : r->buffered;
+    memmove(r->buffer.data(), &r->buffer[keep_from * channels], (r->buffered - keep_from) * channels * sizeof(f32));
+    r->buffered -= keep_from;
+    r->position = position - keep_from;
+    r->phase = phase;
+    return produced;
+}
+
+bool resample_s16(const i16* src, u32 frames, i32 channels, u32 src_rate, u32 dst_rate, u8 quality, std::vector<i16>* dst)
+{
+    const u32 chunk = 1024;
+    resampler_t r;
+    if (!resampler_init(&r, src_rate, dst_rate, channels, quality, chunk))
+        return false;
+
+    const u64 total = (static_cast<u64>(frames) * dst_rate + src_rate - 1) / src_rate;
+    dst->assign(static_cast<size_t>(total * channels), 0);
+
+    std::vector<f32> in(chunk * channels);
+    std::vector<f32> out;
+    u64 written = 0;
+    u32 read = 0;
+    while (written < total)
+    {
+        u32 count = frames - read < chunk ? frames - read : chunk;
+        if (count > 0)
+        {
+            pcm_s16_to_f32(src + static_cast<size_t>(read) * channels, in.data(), count * channels);
+            read += count;
+        }
+        else
+        {
+            // Past the end of the source the filter is flushed with silence.
+            count = chunk;
+            std::fill(in.begin(), in.end(), 0.0f);
+        }
+
+        u32 max_out = static_cast<u32>(static_cast<u64>(count) * dst_rate / src_rate + 2);
+        out.resize(max_out * channels);
+        u32 produced = resampler_process(&r, in.data(), count, out.data(), max_out);
+        if (produced > total - written)
+            produced = static_cast<u32>(total - written);
+        pcm_f32_to_s16(out.data(), dst->data() + written * channels, produced * channels);
+        written += produced;
+    }
+    return true;
+}
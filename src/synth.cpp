@@ -0,0 +1,308 @@
+#include <device.hpp>
+#include <synth.hpp>
+#include <dsp.hpp>
+
+#include <cmath>
+
+#define SYNTH_STAGE_OFF		0x00
+#define SYNTH_STAGE_ATTACK	0x01
+#define SYNTH_STAGE_DECAY	0x02
+#define SYNTH_STAGE_SUSTAIN	0x03
+#define SYNTH_STAGE_RELEASE	0x04
+
+static const f64 SYNTH_PI = 3.14159265358979323846;
+static const f32 SYNTH_FRAC_SCALE = 1.0f / static_cast<f32>(1u << (32 - SYNTH_TABLE_BITS));
+
+struct synth_tables_t
+{
+	// One guard sample per table so interpolation never wraps the index.
+	f32 waves[SYNTH_WAVE_COUNT][SYNTH_TABLE_LEVELS][SYNTH_TABLE_SIZE + 1];
+
+	synth_tables_t()
+	{
+		f32 sine[SYNTH_TABLE_SIZE];
+		for (u32 i = 0; i < SYNTH_TABLE_SIZE; ++i)
+			sine[i] = static_cast<f32>(sin(2.0 * SYNTH_PI * i / SYNTH_TABLE_SIZE));
+
+		for (u32 level = 0; level < SYNTH_TABLE_LEVELS; ++level)
+		{
+			const u32 harmonics = 256u >> level;
+			for (u32 wave = 0; wave < SYNTH_WAVE_COUNT; ++wave)
+			{
+				f32* table = waves[wave][level];
+				f32 peak = 0.0f;
+				for (u32 i = 0; i < SYNTH_TABLE_SIZE; ++i)
+				{
+					// Additive synthesis; sin(h * x) is a lookup at h * i in the sine table.
+					f64 v = 0.0;
+					for (u32 h = 1; h <= harmonics; ++h)
+					{
+						f64 s = sine[(h * i) & (SYNTH_TABLE_SIZE - 1)];
+						if (wave == SYNTH_WAVE_SINE)
+						{
+							v = s;
+							break;
+						}
+						if (wave == SYNTH_WAVE_SAW)
+							v += (h & 1 ? s : -s) / h;
+						else if (h & 1)
+							v += wave == SYNTH_WAVE_SQUARE ? s / h : ((h >> 1) & 1 ? -s : s) / (static_cast<f64>(h) * h);
+					}
+					table[i] = static_cast<f32>(v);
+					peak = fabsf(table[i]) > peak ? fabsf(table[i]) : peak;
+				}
+
+				// Normalize each level so switching tables does not change the loudness.
+				for (u32 i = 0; i < SYNTH_TABLE_SIZE; ++i)
+					table[i] /= peak;
+				table[SYNTH_TABLE_SIZE] = table[0];
+			}
+		}
+	}
+};
+
+static const synth_tables_t& synth_tables()
+{
+    static const synth_tables_t* tables = new synth_tables_t();
+    return *tables;
+}
+
+// Highest table whose harmonics all stay below Nyquist at this phase increment.
+static u32 table_level(u32 increment)
+{
+    u32 level = 0;
+    u64 top = static_cast<u64>(increment) * 256;	// Highest harmonic of level 0, in phase units
+    while (level + 1 < SYNTH_TABLE_LEVELS && top >= 0x80000000ull)
+    {
+        top >>= 1;
+        ++level;
+    }
+    return level;
+}
+
+static u32 oscillator_render(const f32* table, u32 phase, u32 increment, f32* dst, u32 frames)
+{
+    for (u32 i = 0; i < frames; ++i)
+    {
+        u32 index = phase >> (32 - SYNTH_TABLE_BITS);
+        f32 t = static_cast<i32>(phase & ((1u << (32 - SYNTH_TABLE_BITS)) - 1)) * SYNTH_FRAC_SCALE;
+        f32 a = table[index];
+        dst[i] = a + (table[index + 1] - a) * t;
+        phase += increment;
+    }
+    return phase;
+}
+
+// Linear segments, rendered a run at a time rather than testing the stage per sample.
+static void envelope_render(const synth_t* synth, synth_voice_t& voice, f32* dst, u32 frames)
+{
+    const synth_adsr_t& adsr = voice.patch.envelope;
+    const f32 rate = static_cast<f32>(synth->sample_rate);
+    u32 i = 0;
+    while (i < frames)
+    {
+        f32 target = 0.0f, slope = 0.0f;
+        u8 next = SYNTH_STAGE_OFF;
+        switch (voice.stage)
+        {
+        case SYNTH_STAGE_ATTACK:
+            target = 1.0f;
+            slope = 1.0f / (adsr.attack * rate + 1.0f);
+            next = SYNTH_STAGE_DECAY;
+            break;
+        case SYNTH_STAGE_DECAY:
+            target = adsr.sustain;
+            slope = (adsr.sustain - 1.0f) / (adsr.decay * rate + 1.0f);
+            next = SYNTH_STAGE_SUSTAIN;
+            break;
+        case SYNTH_STAGE_RELEASE:
+            target = 0.0f;
+            slope = voice.release_slope;
+            next = SYNTH_STAGE_OFF;
+            break;
+        default:
+            // Sustain and off hold their level for the rest of the block.
+            for (; i < frames; ++i)
+                dst[i] = voice.level;
+            return;
+        }
+
+        f32 distance = (target - voice.level) / slope;
+        u32 remaining = distance > 0.0f ? static_cast<u32>(ceilf(distance)) : 0;
+        u32 count = frames - i < remaining ? frames - i : remaining;
+        for (u32 k = 0; k < count; ++k)
+            dst[i + k] = voice.level + slope * (k + 1);
+        voice.level += slope * count;
+        i += count;
+
+        if (count == remaining)
+        {
+            voice.level = target;
+            voice.stage = next;
+        }
+    }
+}
+
+static f32 voice_gain(const synth_voice_t& voice, f32 lfo)
+{
+    const synth_patch_t& p = voice.patch;
+    return p.gain * voice.velocity * (1.0f - p.lfo_gain * 0.5f * (1.0f + lfo));
+}
+
+static void voice_render_block(synth_t* synth, synth_voice_t& voice, f32* dst, u32 frames)
+{
+    const synth_tables_t& tables = synth_tables();
+    const synth_patch_t& p = voice.patch;
+
+    // Block rate LFO from the sine table, advanced by a whole block.
+    f32 lfo = tables.waves[SYNTH_WAVE_SINE][0][voice.lfo_phase >> (32 - SYNTH_TABLE_BITS)];
+    voice.lfo_phase += static_cast<u32>(p.lfo_rate / synth->sample_rate * 4294967296.0) * frames;
+
+    f32 frequency = voice.frequency;
+    if (p.lfo_pitch != 0.0f)
+        frequency *= exp2f(lfo * p.lfo_pitch / 12.0f);
+    f64 cycles = static_cast<f64>(frequency) / synth->sample_rate;
+    u32 increment = static_cast<u32>((cycles < 0.5 ? cycles : 0.5) * 4294967296.0);
+
+    f32* osc = synth->oscillator.data();
+    f32* env = synth->envelope.data();
+    const f32* table = tables.waves[p.wave < SYNTH_WAVE_COUNT ? p.wave : SYNTH_WAVE_SINE][table_level(increment)];
+    voice.phase = oscillator_render(table, voice.phase, increment, osc, frames);
+    envelope_render(synth, voice, env, frames);
+    dsp_multiply(osc, env, frames);
+
+    f32 gain = voice_gain(voice, lfo);
+    f32 l = gain * voice.pan_l;
+    f32 r = gain * voice.pan_r;
+    f32 dl = (l - voice.gain_l) / frames;
+    f32 dr = (r - voice.gain_r) / frames;
+    if (synth->channels == 1)
+        dsp_mix_to_mono(dst, osc, 1, frames, voice.gain_l, dl);
+    else
+        dsp_mix_mono_to_stereo(dst, osc, frames, voice.gain_l, voice.gain_r, dl, dr);
+    voice.gain_l = l;
+    voice.gain_r = r;
+
+    if (voice.stage == SYNTH_STAGE_OFF)
+        voice.id = 0;
+}
+
+static synth_voice_t* find_voice(synth_t* synth, u32 id)
+{
+    if (id == 0)
+        return nullptr;
+    for (auto& voice : synth->voices)
+        if (voice.id == id)
+            return &voice;
+    return nullptr;
+}
+
+bool synth_init(synth_t* synth, u32 sample_rate, i32 channels, i32 max_voices)
+{
+    if (channels < 1 || channels > 2 || max_voices <= 0 || sample_rate == 0)
+    {
+        LOG_ERROR("Invalid synth configuration");
+        return false;
+    }
+
+    synth_tables();
+    synth->sample_rate = sample_rate;
+    synth->channels = channels;
+    synth->voices.assign(max_voices, synth_voice_t());
+    synth->oscillator.assign(SYNTH_BLOCK_FRAMES, 0.0f);
+    synth->envelope.assign(SYNTH_BLOCK_FRAMES, 0.0f);
+    synth->next_id = 1;
+    return true;
+}
+
+void synth_shutdown(synth_t* synth)
+{
+    synth->voices.clear();
+    synth->oscillator.clear();
+    synth->envelope.clear();
+}
+
+u32 synth_note_on(synth_t* synth, const synth_patch_t& patch, f32 frequency, f32 velocity)
+{
+    synth_voice_t* slot = nullptr;
+    for (auto& voice : synth->voices)
+    {
+        if (voice.id == 0)
+        {
+            slot = &voice;
+            break;
+        }
+        // Ids wrap, so the oldest held voice is found by signed distance.
+        bool releasing = voice.stage == SYNTH_STAGE_RELEASE;
+        bool slot_releasing = slot && slot->stage == SYNTH_STAGE_RELEASE;
+        if (!slot || (releasing && !slot_releasing) ||
+            (releasing == slot_releasing && (releasing ? voice.level < slot->level : static_cast<i32>(voice.id - slot->id) < 0)))
+            slot = &voice;
+    }
+    if (!slot)
+        return 0;
+
+    slot->patch = patch;
+    slot->frequency = frequency;
+    slot->velocity = velocity;
+    slot->phase = 0;
+    slot->lfo_phase = static_cast<u32>(patch.lfo_phase * 4294967296.0);
+    slot->stage = SYNTH_STAGE_ATTACK;
+    slot->level = 0.0f;
+    if (synth->channels == 1)
+    {
+        slot->pan_l = slot->pan_r = 1.0f;
+    }
+    else
+    {
+        f32 angle = (clamp(patch.pan, -1.0f, 1.0f) + 1.0f) * 0.25f * static_cast<f32>(SYNTH_PI);
+        slot->pan_l = cosf(angle);
+        slot->pan_r = sinf(angle);
+    }
+    // Start from silence so a stolen voice does not click.
+    slot->gain_l = slot->gain_r = 0.0f;
+
+    slot->id = synth->next_id++;
+    if (synth->next_id == 0)
+        synth->next_id = 1;
+    return slot->id;
+}
+
+void synth_note_off(synth_t* synth, u32 voice)
+{
+    synth_voice_t* v = find_voice(synth, voice);
+    if (!v || v->stage == SYNTH_STAGE_RELEASE)
+        return;
+    v->stage = SYNTH_STAGE_RELEASE;
+    v->release_slope = -v->level / (v->patch.envelope.release * synth->sample_rate + 1.0f);
+}
+
+void synth_set_frequency(synth_t* synth, u32 voice, f32 frequency)
+{
+    if (synth_voice_t* v = find_voice(synth, voice))
+        v->frequency = frequency;
+}
+
+bool synth_is_playing(const synth_t* synth, u32 voice)
+{
+    return find_voice(const_cast<synth_t*>(synth), voice) != nullptr;
+}
+
+void synth_render(synth_t* synth, f32* samples, i32 frames)
+{
+    memset(samples, 0, frames * synth->channels * sizeof(f32));
+    while (frames > 0)
+    {
+        u32 count = frames < SYNTH_BLOCK_FRAMES ? frames : SYNTH_BLOCK_FRAMES;
+        for (auto& voice : synth->voices)
+            if (voice.id != 0)
+                voice_render_block(synth, voice, samples, count);
+        samples += count * synth->channels;
+        frames -= count;
+    }
+}
+
+void synth_audio_callback_f32(f32* samples, i32 frames, void* userdata)
+{
+    synth_render(static_cast<synth_t*>(userdata), samples, frames);
+}
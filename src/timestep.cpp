@@ -0,0 +1,56 @@
+#include <device.hpp>
+#include <timestep.hpp>
+
+void timestep_init(timestep_t* timestep, f64 rate_hz, u32 max_steps)
+{
+    ASSERT(rate_hz > 0.0 && max_steps > 0, "Invalid timestep %.2f Hz, %u steps", rate_hz, max_steps);
+    timestep->step_ns = static_cast<u64>(1e9 / rate_hz + 0.5);
+    timestep->max_steps = max_steps;
+    timestep->lockstep = false;
+    timestep->accumulator_ns = 0;
+    timestep->last_ns = 0;
+    timestep->ticks = 0;
+    timestep->dropped_ns = 0;
+    timestep->alpha = 0.0f;
+    timestep->started = false;
+}
+
+u32 timestep_advance(timestep_t* timestep, u64 now_ns)
+{
+    // The first frame simulates one step so there is a state to render.
+    if (!timestep->started || timestep->lockstep)
+    {
+        timestep->started = true;
+        timestep->last_ns = now_ns;
+        timestep->accumulator_ns = 0;
+        timestep->alpha = 1.0f;
+        return 1;
+    }
+
+    timestep->accumulator_ns += now_ns - timestep->last_ns;
+    timestep->last_ns = now_ns;
+
+    u64 steps = timestep->accumulator_ns / timestep->step_ns;
+    if (steps > timestep->max_steps)
+    {
+        // Running every missed step would make the next frame later still; let the
+        // simulation fall behind the clock instead of spiralling.
+        timestep->dropped_ns += (steps - timestep->max_steps) * timestep->step_ns;
+        steps = timestep->max_steps;
+    }
+    timestep->accumulator_ns -= steps * timestep->step_ns;
+    if (timestep->accumulator_ns >= timestep->step_ns)
+        timestep->accumulator_ns %= timestep->step_ns;
+
+    timestep->alpha = static_cast<f32>(timestep->accumulator_ns) / timestep->step_ns;
+    return static_cast<u32>(steps);
+}
+
+void timestep_run(timestep_t* timestep, u64 now_ns, timestep_tick_t tick, timestep_render_t render, void* userdata)
+{
+    u32 steps = timestep_advance(timestep, now_ns);
+    const f64 dt = timestep->step_ns * 1e-9;
+    for (u32 i = 0; i < steps; ++i)
+        tick(dt, timestep->ticks++, userdata);
+    render(timestep->alpha, userdata);
+}
@@ -0,0 +1,208 @@
+#include <wav.hpp>
+#include <device.hpp>
+
+// RIFF is little endian; write byte by byte so the host order does not matter.
+static void write_u16(FILE* file, u16 v)
+{
+    u8 bytes[2] = { static_cast<u8>(v), static_cast<u8>(v >> 8) };
+    fwrite(bytes, 1, 2, file);
+}
+
+static void write_u32(FILE* file, u32 v)
+{
+    u8 bytes[4] = { static_cast<u8>(v), static_cast<u8>(v >> 8), static_cast<u8>(v >> 16), static_cast<u8>(v >> 24) };
+    fwrite(bytes, 1, 4, file);
+}
+
+static u32 sample_bytes(u16 format)
+{
+    return format == WAV_FORMAT_IEEE_FLOAT ? sizeof(f32) : sizeof(i16);
+}
+
+// Float files carry an extended fmt chunk and a fact chunk, as the format requires.
+static u32 header_bytes(u16 format)
+{
+    return format == WAV_FORMAT_IEEE_FLOAT ? 58 : 44;
+}
+
+static void write_header(wav_writer_t* writer)
+{
+    const u32 sample_rate = writer->sample_rate;
+    FILE* file = writer->file;
+    const bool is_float = writer->format == WAV_FORMAT_IEEE_FLOAT;
+    const u32 block_align = writer->channels * sample_bytes(writer->format);
+
+    fwrite("RIFF", 1, 4, file);
+    write_u32(file, header_bytes(writer->format) - 8 + writer->data_bytes);
+    fwrite("WAVE", 1, 4, file);
+
+    fwrite("fmt ", 1, 4, file);
+    write_u32(file, is_float ? 18 : 16);
+    write_u16(file, writer->format);
+    write_u16(file, static_cast<u16>(writer->channels));
+    write_u32(file, sample_rate);
+    write_u32(file, sample_rate * block_align);
+    write_u16(file, static_cast<u16>(block_align));
+    write_u16(file, static_cast<u16>(sample_bytes(writer->format) * 8));
+    if (is_float)
+    {
+        write_u16(file, 0);
+        fwrite("fact", 1, 4, file);
+        write_u32(file, 4);
+        write_u32(file, writer->data_bytes / block_align);
+    }
+
+    fwrite("data", 1, 4, file);
+    write_u32(file, writer->data_bytes);
+}
+
+bool wav_open(wav_writer_t* writer, const char* path, u32 sample_rate, i32 channels, u16 format)
+{
+    writer->file = fopen(path, "wb");
+    if (!writer->file)
+    {
+        LOG_ERROR("Failed to open %s for writing", path);
+        return false;
+    }
+
+    writer->format = format;
+    writer->sample_rate = sample_rate;
+    writer->channels = channels;
+    writer->data_bytes = 0;
+    write_header(writer);
+    return true;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define WAV_WRITE_SWAP_BYTES
+#define WAV_WRITE_SWAP_CHUNK 4096
+#endif
+
+// Samples go out in little endian order; big endian hosts swap them through a small buffer.
+static bool write_samples(FILE* file, const void* samples, u32 bytes, u32 width)
+{
+#if defined(WAV_WRITE_SWAP_BYTES)
+    const u8* src = static_cast<const u8*>(samples);
+    u8 swapped[WAV_WRITE_SWAP_CHUNK];
+    while (bytes > 0)
+    {
+        u32 n = bytes < WAV_WRITE_SWAP_CHUNK ? bytes : WAV_WRITE_SWAP_CHUNK;
+        for (u32 i = 0; i < n; i += width)
+            for (u32 b = 0; b < width; ++b)
+                swapped[i + b] = src[i + width - 1 - b];
+        if (fwrite(swapped, 1, n, file) != n)
+            return false;
+        src += n;
+        bytes -= n;
+    }
+    return true;
+#else
+    (void)width;
+    return fwrite(samples, 1, bytes, file) == bytes;
+#endif
+}
+
+bool wav_write(wav_writer_t* writer, const void* samples, u32 frames)
+{
+    const u32 width = sample_bytes(writer->format);
+    const u32 bytes = frames * writer->channels * width;
+    if (!write_samples(writer->file, samples, bytes, width))
+    {
+        LOG_ERROR("Failed to write WAV data");
+        return false;
+    }
+    writer->data_bytes += bytes;
+    return true;
+}
+
+void wav_close(wav_writer_t* writer)
+{
+    if (!writer->file)
+        return;
+
+    fseek(writer->file, 0, SEEK_SET);
+    write_header(writer);
+
+    fclose(writer->file);
+    writer->file = nullptr;
+}
+
+static u16 read_u16(const u8* p)
+{
+    return static_cast<u16>(p[0] | p[1] << 8);
+}
+
+static u32 read_u32(const u8* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<u32>(p[3]) << 24;
+}
+
+bool wav_parse(const u8* file, size_t size, wav_info_t* info)
+{
+    if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0)
+    {
+        LOG_ERROR("Not a RIFF/WAVE file");
+        return false;
+    }
+
+    memset(info, 0, sizeof(*info));
+    u32 fact_frames = 0;
+    bool has_fmt = false;
+    u16 bits = 0;
+
+    size_t offset = 12;
+    while (offset + 8 <= size)
+    {
+        const u8* chunk = file + offset;
+        u32 chunk_bytes = read_u32(chunk + 4);
+        const u8* body = chunk + 8;
+        size_t body_bytes = size - offset - 8 < chunk_bytes ? size - offset - 8 : chunk_bytes;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && body_bytes >= 16)
+        {
+            info->format = read_u16(body);
+            info->channels = read_u16(body + 2);
+            info->sample_rate = read_u32(body + 4);
+            info->block_align = read_u16(body + 12);
+            bits = read_u16(body + 14);
+            info->frames_per_block = 1;
+            if (info->format == WAV_FORMAT_IMA_ADPCM && body_bytes >= 20)
+                info->frames_per_block = read_u16(body + 18);
+            has_fmt = true;
+        }
+        else if (memcmp(chunk, "fact", 4) == 0 && body_bytes >= 4)
+        {
+            fact_frames = read_u32(body);
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            info->data = body;
+            info->data_bytes = static_cast<u32>(body_bytes);
+        }
+
+        // Chunks are padded to an even size.
+        offset += 8 + static_cast<size_t>(chunk_bytes) + (chunk_bytes & 1);
+    }
+
+    if (!has_fmt || !info->data || info->channels < 1 || info->block_align == 0)
+    {
+        LOG_ERROR("WAV file is missing its fmt or data chunk");
+        return false;
+    }
+
+    if (info->format == WAV_FORMAT_PCM && bits == 16)
+    {
+        info->frames = info->data_bytes / info->block_align;
+    }
+    else if (info->format == WAV_FORMAT_IMA_ADPCM && bits == 4 && info->frames_per_block > 0)
+    {
+        u32 blocks = (info->data_bytes + info->block_align - 1) / info->block_align;
+        info->frames = fact_frames ? fact_frames : blocks * info->frames_per_block;
+    }
+    else
+    {
+        LOG_ERROR("Unsupported WAV format 0x%04x with %u bits per sample", info->format, bits);
+        return false;
+    }
+    return true;
+}